@@ -31,6 +31,12 @@
 #define _CHIBIOS_RT_CONF_
 #define _CHIBIOS_RT_CONF_VER_7_0_
 
+/* Lean profile (make USE_PROFILE=lean), overrides the services below that
+   the application does not use.*/
+#if defined(CH_PROFILE_LEAN)
+#include "chconf_lean.h"
+#endif
+
 /*===========================================================================*/
 /**
  * @name System settings
@@ -100,7 +106,7 @@
  *          this value.
  */
 #if !defined(CH_CFG_ST_TIMEDELTA)
-#define CH_CFG_ST_TIMEDELTA                 0//2
+#define CH_CFG_ST_TIMEDELTA                 2
 #endif
 
 /** @} */
@@ -749,9 +755,16 @@
  *          should be invoked from here.
  * @note    This macro can be used to activate a power saving mode.
  */
+#if defined(IDLE_REPORT)
+#define CH_CFG_IDLE_ENTER_HOOK() {                                          \
+  /* Idle time accounting of the serial monitor, USE_IDLE_REPORT=yes.*/    \
+  IdleEnterHook();                                                          \
+}
+#else
 #define CH_CFG_IDLE_ENTER_HOOK() {                                          \
   /* Idle-enter code here.*/                                                \
 }
+#endif
 
 /**
  * @brief   Idle thread leave hook.
@@ -759,16 +772,26 @@
  *          should be invoked from here.
  * @note    This macro can be used to deactivate a power saving mode.
  */
+#if defined(IDLE_REPORT)
+#define CH_CFG_IDLE_LEAVE_HOOK() {                                          \
+  IdleLeaveHook();                                                          \
+}
+#else
 #define CH_CFG_IDLE_LEAVE_HOOK() {                                          \
   /* Idle-leave code here.*/                                                \
 }
+#endif
 
 /**
  * @brief   Idle Loop hook.
  * @details This hook is continuously invoked by the idle thread loop.
  */
 #define CH_CFG_IDLE_LOOP_HOOK() {                                           \
-  /* Idle loop code here.*/                                                 \
+  /* Idle sleep mode, the CPU halts until the next interrupt while the      \
+     system timer and the USART keep running.*/                             \
+  SMCR = (1 << SE);                                                         \
+  __asm__ volatile ("sleep" : : : "memory");                                \
+  SMCR = 0;                                                                 \
 }
 
 /**
@@ -812,6 +835,20 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+/* Idle thread stack from the measured peaks, USE_MEASURED_STACKS=yes */
+#if defined(MEASURED_STACKS)
+#include "../stacks.h"
+#if defined(WA_IDLE_SIZE)
+#define PORT_IDLE_THREAD_STACK_SIZE WA_IDLE_SIZE
+#endif
+#endif
+
+/* Idle time accounting hooks, main.c, called with the system locked */
+#if defined(IDLE_REPORT) && !defined(_FROM_ASM_)
+void IdleEnterHook(void);
+void IdleLeaveHook(void);
+#endif
+
 #endif  /* CHCONF_H */
 
 /** @} */
@@ -0,0 +1,34 @@
+/*
+  * Lean kernel profile, selected with make USE_PROFILE=lean.
+  *
+  * The application uses threads, events (with the serial driver flags),
+  * virtual timers and time stamps; the HAL serial driver only needs the
+  * threads queues. Every other kernel service is compiled out, chconf.h
+  * keeps its defaults for the settings not listed here.
+*/
+
+#ifndef CHCONF_LEAN_H
+#define CHCONF_LEAN_H
+
+#define CH_CFG_OPTIMIZE_SPEED               FALSE
+
+#define CH_CFG_USE_REGISTRY                 FALSE
+#define CH_CFG_USE_WAITEXIT                 FALSE
+#define CH_CFG_USE_SEMAPHORES               FALSE
+#define CH_CFG_USE_MUTEXES                  FALSE
+#define CH_CFG_USE_CONDVARS                 FALSE
+#define CH_CFG_USE_CONDVARS_TIMEOUT         FALSE
+#define CH_CFG_USE_EVENTS_TIMEOUT           FALSE
+#define CH_CFG_USE_MESSAGES                 FALSE
+#define CH_CFG_USE_MAILBOXES                FALSE
+#define CH_CFG_USE_MEMCORE                  FALSE
+#define CH_CFG_USE_HEAP                     FALSE
+#define CH_CFG_USE_MEMPOOLS                 FALSE
+#define CH_CFG_USE_OBJ_FIFOS                FALSE
+#define CH_CFG_USE_PIPES                    FALSE
+#define CH_CFG_USE_OBJ_CACHES               FALSE
+#define CH_CFG_USE_DELEGATES                FALSE
+#define CH_CFG_USE_JOBS                     FALSE
+#define CH_CFG_USE_FACTORY                  FALSE
+
+#endif
@@ -42,6 +42,7 @@
 
 /*
  * PCINT driver system settings.
+ * Note: PCINT0_vect (buttons on PB1..PB4) is serviced directly by main.c.
  */
 #define AVR_EXT_USE_PCINT0                 FALSE
 #define AVR_EXT_USE_PCINT1                 FALSE
@@ -0,0 +1,139 @@
+/*
+  * Table driven phase controller.
+  *
+  * The controller is a small engine evaluating two constant tables: the
+  * phase descriptors (lamps, durations) and the transition table indexed by
+  * (phase, pending requests), both generated from the declarative
+  * description of the intersection. It has no dependency on ChibiOS, the
+  * caller provides the time and writes the lamps.
+  *
+  * Time is only looked at on decision points: the end of the phase minimum
+  * (shortened when preempted) and the blink toggles. ctlWaitMs() tells the
+  * caller when the next one is due so a single one-shot timer is armed per
+  * phase instead of a periodic tick, and a phase waiting for a request arms
+  * none at all.
+*/
+
+#include "controller.h"
+#include "rom.h"
+
+typedef struct
+{
+  uint8_t  lamps;         // Lamps lit when the phase starts
+  uint8_t  blink;         // Lamps toggled every blink_ms
+  uint16_t ms;            // Milliseconds before the phase can end
+  uint16_t preempt_ms;    // Milliseconds before the phase can end when preempted
+  uint8_t  preempt;       // Requests preempting the phase
+  uint8_t  serves;        // Requests served, cleared when the phase starts
+  uint16_t blink_ms;      // Blink half period, 0 for steady lamps
+} phase_desc_t;
+
+/*
+  * Phase descriptors and transition table, generated by tools/intersection.py
+  * from intersection.json. The transition rules of each phase are ordered,
+  * the first one matching a pending request gives the next phase and a rule
+  * returning its own phase keeps the phase running.
+*/
+#include "intersection_tables.h"
+
+static void ctlServe(controller_t *ctl, uint8_t served)
+{
+  ctl->pending &= ~served;
+}
+
+static void ctlEnter(controller_t *ctl, uint8_t phase)
+{
+  const phase_desc_t *p = &phases[phase];
+
+  ctl->phase = phase;
+  ctl->elapsed = 0;
+  ctl->lamps = rom_byte(&p->lamps);
+  ctlServe(ctl, rom_byte(&p->serves));
+}
+
+void ctlInit(controller_t *ctl)
+{
+  ctl->pending = 0;
+  ctlEnter(ctl, PH_INITIAL);
+}
+
+/*
+  * Requests are coalesced in the pending mask, pressing a button again
+  * before its request is served costs nothing and no request is lost when
+  * several arrive close together.
+*/
+void ctlInput(controller_t *ctl, uint8_t event)
+{
+  if (event == PEDESTRE)
+    ctl->pending |= REQ_PEDESTRE;
+  else if (event == CARRO_SECUNDARIA)
+    ctl->pending |= REQ_CARRO;
+  else if (event == AMBULANCIA_PRINCIPAL)
+    ctl->pending ^= REQ_AMB_PRI;
+  else if (event == AMBULANCIA_SECUNDARIA)
+    ctl->pending ^= REQ_AMB_SEC;
+}
+
+uint8_t ctlRequests(const controller_t *ctl)
+{
+  return ctl->pending;
+}
+
+static uint16_t ctlLimit(const controller_t *ctl, const phase_desc_t *p)
+{
+  return (ctlRequests(ctl) & rom_byte(&p->preempt)) ? rom_word(&p->preempt_ms)
+                                                     : rom_word(&p->ms);
+}
+
+/*
+  * Advances the phase by the ms elapsed since the previous call and takes
+  * the decisions due by now. Called early it only accounts the time, so the
+  * caller may also run it when a request arrives.
+*/
+uint8_t ctlTick(controller_t *ctl, uint16_t ms)
+{
+  const phase_desc_t *p = &phases[ctl->phase];
+  uint16_t blink_ms = rom_word(&p->blink_ms);
+  uint16_t before = ctl->elapsed;
+  uint8_t req = ctlRequests(ctl);
+  uint8_t next, changes = 0;
+
+  ctl->elapsed = (before > UINT16_MAX - ms) ? UINT16_MAX : before + ms;
+
+  if (blink_ms && ((ctl->elapsed / blink_ms - before / blink_ms) & 1))
+  {
+    ctl->lamps ^= rom_byte(&p->blink);
+    changes |= CTL_LAMPS_CHANGED;
+  }
+
+  if (ctl->elapsed < ctlLimit(ctl, p))
+    return changes;
+
+  next = rom_byte(&transitions[ctl->phase][req]);
+  if (next == ctl->phase)
+    return changes;
+
+  ctlEnter(ctl, next);
+  return CTL_LAMPS_CHANGED | CTL_PHASE_CHANGED;
+}
+
+/*
+  * Milliseconds from the last ctlTick() to the next decision point, or
+  * CTL_WAIT_NONE when the phase is past its minimum and holds until a
+  * request arrives.
+*/
+uint16_t ctlWaitMs(const controller_t *ctl)
+{
+  const phase_desc_t *p = &phases[ctl->phase];
+  uint16_t blink_ms = rom_word(&p->blink_ms);
+  uint16_t limit = ctlLimit(ctl, p);
+  uint16_t wait = CTL_WAIT_NONE;
+
+  if (ctl->elapsed < limit)
+    wait = limit - ctl->elapsed;
+
+  if (blink_ms && blink_ms - ctl->elapsed % blink_ms < wait)
+    wait = blink_ms - ctl->elapsed % blink_ms;
+
+  return wait;
+}
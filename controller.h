@@ -0,0 +1,53 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+#include "definitions.h"
+
+/*
+  * Signal lamps, one bit per LED of the three signal heads
+*/
+#define LAMP_VERDE_PRINCIPAL     (1 << 0)
+#define LAMP_AMARELO_PRINCIPAL   (1 << 1)
+#define LAMP_VERMELHO_PRINCIPAL  (1 << 2)
+#define LAMP_VERDE_SECUNDARIA    (1 << 3)
+#define LAMP_AMARELO_SECUNDARIA  (1 << 4)
+#define LAMP_VERMELHO_SECUNDARIA (1 << 5)
+#define LAMP_VERMELHO_PEDESTRE   (1 << 6)
+#define LAMP_VERDE_PEDESTRE      (1 << 7)
+#define LAMP_COUNT               8
+
+/*
+  * Pending requests, the column index of the transition table
+*/
+#define REQ_PEDESTRE  (1 << 0)
+#define REQ_CARRO     (1 << 1)
+#define REQ_AMB_PRI   (1 << 2)
+#define REQ_AMB_SEC   (1 << 3)
+#define REQ_COUNT     16
+
+/* Phases, phase_t, are generated in intersection.h from intersection.json */
+
+/* ctlTick() results */
+#define CTL_LAMPS_CHANGED (1 << 0)
+#define CTL_PHASE_CHANGED (1 << 1)
+
+/* ctlWaitMs() result when the phase only ends on a new request */
+#define CTL_WAIT_NONE     UINT16_MAX
+
+typedef struct
+{
+  uint8_t phase;        // Current phase_t
+  uint8_t lamps;        // LAMP_* currently lit
+  uint8_t pending;      // REQ_* waiting to be served, the ambulances ones are
+                        // toggled by their buttons and never served
+  uint16_t elapsed;     // Milliseconds spent in the current phase, saturated
+} controller_t;
+
+void ctlInit(controller_t *ctl);
+void ctlInput(controller_t *ctl, uint8_t event);
+uint8_t ctlRequests(const controller_t *ctl);
+uint8_t ctlTick(controller_t *ctl, uint16_t ms);
+uint16_t ctlWaitMs(const controller_t *ctl);
+
+#endif
@@ -1,7 +1,30 @@
 #ifndef DEFINITIONS_H
 #define DEFINITIONS_H
 
-#define QUEUE_SIZE 128
+#define QUEUE_SIZE 32 // Messages per priority class
+
+/* Intersections driven by the board, each one has its own signal heads */
+#define INTERSECTIONS 1
+//#define COLLECT_TIMEOUT_MS 1000 // Read Event housekeeping period
+
+/*
+  * Threads working areas, USE_MEASURED_STACKS=yes takes them from stacks.h,
+  * generated by tools/stacks.py from the measured peaks.
+*/
+#if defined(MEASURED_STACKS)
+#include "stacks.h"
+#endif
+
+#if !defined(WA_READ_EVENT_SIZE)
+#define WA_READ_EVENT_SIZE    128
+#endif
+#if !defined(WA_PROCESS_EVENT_SIZE)
+#define WA_PROCESS_EVENT_SIZE 128
+#endif
+
+/* Buttons */
+#define DEBOUNCE_MS  20
+#define BUTTONS_PADS 5 // PB0..PB4, indexed by pad
 
 /* GPIOs */
 // Events
@@ -10,17 +33,14 @@
 #define EVENT_3 2 // PB2
 #define EVENT_4 1 // PB1
 
-// Leds
-#define LED_VERDE_PRINCIPAL    0 // PB0
-#define LED_AMARELO_PRINCIPAL  7 // PD7
-#define LED_VERMELHO_PRINCIPAL 6 // PD6
-
-#define LED_VERDE_SECUNDARIA    5 // PD5
-#define LED_AMARELO_SECUNDARIA  4 // PD4
-#define LED_VERMELHO_SECUNDARIA 3 // PD3
+// Leds port groups, the pads of each lamp come from intersection.json
+#define LAMP_PORT_B 0 // IOPORT2
+#define LAMP_PORT_C 1 // IOPORT3
+#define LAMP_PORT_D 2 // IOPORT4
+#define LAMP_PORTS  3
 
-#define LED_VERMELHO_PEDESTRE   0 // PC0
-#define LED_VERDE_PEDESTRE      1 // PC1
+/* Lamps pads, timings and phases, generated from intersection.json */
+#include "intersection.h"
 
 /* Events */
 #define PEDESTRE              EVENT_1
@@ -28,19 +48,26 @@
 #define AMBULANCIA_PRINCIPAL  EVENT_3
 #define AMBULANCIA_SECUNDARIA EVENT_4
 
-typedef enum 
-{
-    IDLE_ST = 0,
-    PRINCIPAL,
-    SECUNDARIA,
-    _PEDESTRE
-} state_via_t;
-
-typedef enum 
-{
-    VERDE = 0,
-    AMARELO,
-    VERMELHO
-} state_LED_t;
-
-#endif
\ No newline at end of file
+#define BUTTONS_MASK ((1 << PEDESTRE) | (1 << CARRO_SECUNDARIA) | \
+                      (1 << AMBULANCIA_PRINCIPAL) | (1 << AMBULANCIA_SECUNDARIA))
+
+/* Telemetry records buffered for the serial port */
+#define TLM_RING_SIZE 16
+
+/* Event queue priority classes, class 0 is collected first. The phase
+   timer expiries have their own class ahead of every button, a burst of
+   presses never delays a phase change */
+#define QUEUE_CLASSES                  4
+#define PRIORITY_PHASE                 0
+#define PRIORITY_AMBULANCIA_PRINCIPAL  1
+#define PRIORITY_AMBULANCIA_SECUNDARIA 1
+#define PRIORITY_PEDESTRE              2
+#define PRIORITY_CARRO_SECUNDARIA      3
+
+/* Buttons toggling a state, each press counts and is never coalesced */
+#define BUTTONS_TOGGLE ((1 << AMBULANCIA_PRINCIPAL) | (1 << AMBULANCIA_SECUNDARIA))
+
+/* Intersection owning the button on a PORTB pad */
+#define BUTTON_INTERSECTION(pad) 0
+
+#endif
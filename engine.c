@@ -0,0 +1,153 @@
+/*
+  * Intersection engine, the path from a button press to the controller and
+  * the phase timer, shared by the firmware and the host simulation.
+  *
+  * Buttons presses and phase timer expiries are posted to the event queue
+  * (engPressI, engPhaseTick) and the collector runs the controller on them
+  * (engCollect), in thread context. The kernel calls are the ChibiOS RT
+  * ones, the host build provides them on its virtual clock (sim/ch.h); the
+  * queue, the lamps and the telemetry are the application's, through the
+  * engine hooks.
+*/
+
+#include "engine.h"
+#include "evqueue.h"
+#include "telemetry.h"
+
+static uint16_t PhaseElapsed(intersection_t *isp);
+static void PhaseRun(intersection_t *isp);
+
+void engInit(intersection_t *isp, uint8_t id, const lamp_map_t *lamps)
+{
+  isp->id = id;
+  isp->lamps = lamps;
+  ctlInit(&isp->ctl);
+  latInit(&isp->lat, CH_CFG_ST_FREQUENCY);
+  chVTObjectInit(&isp->vt);
+}
+
+/*
+  * A press already waiting in the queue is only counted, the queue holds at
+  * most one message per request button whatever the presses rate.
+*/
+void engPressI(intersection_t *isp, uint8_t pad, systimestamp_t now)
+{
+  uint8_t bit = PAL_PORT_BIT(pad);
+
+  isp->arrivals[pad]++;
+  engTelemetryI(TLM_ARRIVAL, isp->id, pad, isp->arrivals[pad], now);
+  if ((isp->queued & bit) && (BUTTONS_TOGGLE & bit) == 0)
+    return;
+
+  if (engPostI(EVQ_MSG(isp->id, pad)))
+  {
+    isp->queued |= bit;
+    isp->pressed[pad] = now;
+  }
+}
+
+/* Collector side of a queued message, a phase timer expiry only runs the
+   controller */
+void engCollect(intersection_t *isp, uint8_t event)
+{
+  uint8_t before;
+  systimestamp_t pressed, now;
+
+  if (event != EVQ_PHASE)
+  {
+    /* The queued presses are shared with the buttons interrupt, the
+       histogram update and its divisions run after the lock.*/
+    chSysLock();
+    isp->queued &= ~PAL_PORT_BIT(event);
+    pressed = isp->pressed[event];
+    now = chVTGetTimeStampI();
+    engTelemetryI(TLM_COLLECT, isp->id, event, evqCount(), now);
+    chSysUnlock();
+
+    /* The latency timestamps are the low 32 bits of the time stamps */
+    before = ctlRequests(&isp->ctl);
+    ctlInput(&isp->ctl, event);
+    latRequests(&isp->lat, before, ctlRequests(&isp->ctl),
+                (uint32_t)pressed, (uint32_t)now);
+  }
+
+  PhaseRun(isp);
+}
+
+/*
+  * Phase timer, a single one-shot timer per intersection armed on the next
+  * decision point of its controller: the end of the phase or a blink toggle.
+  * A phase holding for a request only arms it as a keepalive, nothing is
+  * posted on its expiry, and a new request runs the controller again, so
+  * the deadline follows the preemptions.
+  *
+  * chVTGetTimeStampI() extends the 16 bits system time with the wraps seen
+  * since its previous call and loses one when two calls are more than a
+  * wrap apart (4.19 s). The timer callback takes a time stamp and the timer
+  * is always armed within PHASE_WAIT_MAX_MS, so the press and green stamps
+  * of the latency histograms stay exact through any quiet period.
+  *
+  * The timer callback only posts the expiry to the event queue and the
+  * controller runs in the collector, in thread context and without the
+  * kernel lock: the collector is its only writer and the lamps writer only
+  * loads its lamps byte.
+*/
+
+/* Milliseconds since the phase timer was armed, capped at its wait: the
+   expiry is collected a bit late and the controller never runs past its
+   deadline.*/
+static uint16_t PhaseElapsed(intersection_t *isp)
+{
+  sysinterval_t since = chTimeDiffX(isp->armed_at, chVTGetSystemTimeX());
+  uint16_t ms = (uint16_t)TIME_I2MS(since);
+
+  return ms < isp->wait ? ms : isp->wait;
+}
+
+/* Runs the controller over the ms elapsed and re-arms the phase timer */
+static void PhaseRun(intersection_t *isp)
+{
+  uint8_t changes = ctlTick(&isp->ctl, isp->wait ? PhaseElapsed(isp) : 0);
+  uint16_t wait = ctlWaitMs(&isp->ctl);
+  sysinterval_t interval;
+
+  if (wait == CTL_WAIT_NONE)
+    wait = 0;
+  else if (wait > PHASE_WAIT_MAX_MS)
+    wait = PHASE_WAIT_MAX_MS;
+
+  /* The ms to ticks conversion is 64 bits arithmetic, kept out of the lock */
+  interval = TIME_MS2I(wait != 0 ? wait : PHASE_WAIT_MAX_MS);
+
+  chSysLock();
+  if (changes != 0)
+    engChangedI(isp, changes);
+  if (changes & CTL_PHASE_CHANGED)
+    engTelemetryI(TLM_PHASE, isp->id, isp->ctl.phase, isp->ctl.lamps,
+                  chVTGetTimeStampI());
+  chSchRescheduleS();
+  chSysUnlock();
+
+  chSysLock();
+  if (chVTIsArmedI(&isp->vt))
+    chVTResetI(&isp->vt);
+  isp->wait = wait;
+  isp->armed_at = chVTGetSystemTimeX();
+  chVTSetI(&isp->vt, interval, engPhaseTick, isp);
+  chSysUnlock();
+}
+
+/* RT7 timer callback, the kernel passes the timer and its argument and runs
+   it out of the kernel lock. A holding phase only re-arms the keepalive. */
+void engPhaseTick(virtual_timer_t *vtp, void *arg)
+{
+  intersection_t *isp = (intersection_t *)arg;
+
+  chSysLockFromISR();
+  (void)chVTGetTimeStampI();
+  if (isp->wait == 0)
+    chVTSetI(vtp, TIME_MS2I(PHASE_WAIT_MAX_MS), engPhaseTick, isp);
+  else if (!engPostI(EVQ_MSG(isp->id, EVQ_PHASE)))
+    chVTSetI(vtp, TIME_MS2I(PHASE_RETRY_MS), engPhaseTick, isp);
+  chSysUnlockFromISR();
+}
@@ -0,0 +1,56 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+#include "controller.h"
+#include "lamps.h"
+#include "latency.h"
+
+/*
+  * Intersections, all the state of one intersection lives in its object so
+  * the same engine drives any number of them.
+*/
+typedef struct
+{
+  controller_t ctl;
+  virtual_timer_t vt;
+  uint16_t wait;                     // Armed phase deadline in ms, 0 when holding
+  systime_t armed_at;
+  const lamp_map_t *lamps;
+  uint8_t id;
+  uint8_t queued;                    // Buttons with a press in the queue
+  uint16_t arrivals[BUTTONS_PADS];   // Presses of each button, coalesced included
+  systimestamp_t pressed[BUTTONS_PADS]; // Press of each queued message
+  latency_t lat;                     // Press-to-green latency histograms
+} intersection_t;
+
+/* 16 bits intervals at CH_CFG_ST_FREQUENCY cover a bit more than 4 s, longer
+   phases take an intermediate wakeup and holding phases a keepalive */
+#define PHASE_WAIT_MAX_MS 4000
+
+/* Expiry posted again after this delay when the event queue is full */
+#define PHASE_RETRY_MS    1
+
+void engInit(intersection_t *isp, uint8_t id, const lamp_map_t *lamps);
+void engPressI(intersection_t *isp, uint8_t pad, systimestamp_t now);
+void engCollect(intersection_t *isp, uint8_t event);
+void engPhaseTick(virtual_timer_t *vtp, void *arg);
+
+/*
+  * Application hooks, the firmware implements them on its threads and the
+  * host simulation on its virtual clock. All are called with the system
+  * locked.
+*/
+/* Queues a message for engCollect() and wakes its consumer up, false when
+   the queue is full */
+bool engPostI(uint8_t msg);
+/* Controller changes (CTL_*_CHANGED) of a run, the lamps are the
+   application's to write */
+void engChangedI(intersection_t *isp, uint8_t changes);
+/* Telemetry record, see telemetry.h */
+void engTelemetryI(uint8_t type, uint8_t id, uint8_t a, uint16_t b,
+                   systimestamp_t now);
+
+#endif
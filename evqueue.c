@@ -0,0 +1,145 @@
+/*
+  * Event queue, single producer (PCINT ISR and phase timers, which never
+  * nest) and single consumer (Read Event) priority queue. Each priority
+  * class has its own ring and the consumer always drains the highest
+  * priority class first, an ambulance press never waits behind pedestrian
+  * or car requests.
+  *
+  * The indexes are free running bytes so each side only writes its own
+  * index with a single, atomic store and no lock is needed on the hot path.
+  * Waking up the consumer is left to the caller.
+*/
+
+#include "evqueue.h"
+#include "rom.h"
+
+#if (QUEUE_SIZE & (QUEUE_SIZE - 1)) != 0 || QUEUE_SIZE > 128
+#error "QUEUE_SIZE must be a power of two not greater than 128"
+#endif
+
+#if PRIORITY_AMBULANCIA_PRINCIPAL >= QUEUE_CLASSES ||                     \
+    PRIORITY_AMBULANCIA_SECUNDARIA >= QUEUE_CLASSES ||                    \
+    PRIORITY_PEDESTRE >= QUEUE_CLASSES ||                                 \
+    PRIORITY_CARRO_SECUNDARIA >= QUEUE_CLASSES
+#error "PRIORITY_* must be lower than QUEUE_CLASSES"
+#endif
+
+#if PRIORITY_PHASE >= PRIORITY_AMBULANCIA_PRINCIPAL ||                    \
+    PRIORITY_PHASE >= PRIORITY_AMBULANCIA_SECUNDARIA ||                   \
+    PRIORITY_PHASE >= PRIORITY_PEDESTRE ||                                \
+    PRIORITY_PHASE >= PRIORITY_CARRO_SECUNDARIA
+#error "PRIORITY_PHASE must be ahead of every button class"
+#endif
+
+#define QUEUE_MASK      (QUEUE_SIZE - 1)
+
+/* Keeps the compiler from moving slot accesses across the index update */
+#define QUEUE_BARRIER() __asm__ volatile ("" : : : "memory")
+
+typedef struct
+{
+  uint8_t slots[QUEUE_SIZE];
+  volatile uint8_t head, tail;
+} evq_ring_t;
+
+static evq_ring_t rings[QUEUE_CLASSES];
+
+/* Priority class of each event, the phase expiries their own, other pads
+   get the lowest priority */
+#define EVENT_CLASS(event)                                                 \
+  ((event) == EVQ_PHASE ? PRIORITY_PHASE :                                 \
+   (event) == AMBULANCIA_PRINCIPAL ? PRIORITY_AMBULANCIA_PRINCIPAL :       \
+   (event) == AMBULANCIA_SECUNDARIA ? PRIORITY_AMBULANCIA_SECUNDARIA :     \
+   (event) == PEDESTRE ? PRIORITY_PEDESTRE :                               \
+   (event) == CARRO_SECUNDARIA ? PRIORITY_CARRO_SECUNDARIA :               \
+   QUEUE_CLASSES - 1)
+
+static const uint8_t event_class[8] ROM =
+{
+  EVENT_CLASS(0), EVENT_CLASS(1), EVENT_CLASS(2), EVENT_CLASS(3),
+  EVENT_CLASS(4), EVENT_CLASS(5), EVENT_CLASS(6), EVENT_CLASS(7)
+};
+
+static bool ringIsEmpty(const evq_ring_t *rp)
+{
+  return rp->head == rp->tail;
+}
+
+static bool ringIsFull(const evq_ring_t *rp)
+{
+  return (uint8_t)(rp->head - rp->tail) >= QUEUE_SIZE;
+}
+
+void evqInit(void)
+{
+  for (uint8_t c = 0; c < QUEUE_CLASSES; c++)
+    rings[c].head = rings[c].tail = 0;
+}
+
+bool evqPut(uint8_t msg)
+{
+  evq_ring_t *rp = &rings[rom_byte(&event_class[EVQ_EVENT(msg)])];
+
+  if (ringIsFull(rp))
+    return false;
+
+  /* Writing the message in the queue before publishing it.*/
+  rp->slots[rp->head & QUEUE_MASK] = msg;
+  QUEUE_BARRIER();
+  rp->head++;
+
+  return true;
+}
+
+bool evqGet(uint8_t *msgp)
+{
+  for (uint8_t c = 0; c < QUEUE_CLASSES; c++)
+  {
+    evq_ring_t *rp = &rings[c];
+
+    if (ringIsEmpty(rp))
+      continue;
+
+    /* Reading the message before releasing its slot.*/
+    *msgp = rp->slots[rp->tail & QUEUE_MASK];
+    QUEUE_BARRIER();
+    rp->tail++;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool evqIsEmpty(void)
+{
+  for (uint8_t c = 0; c < QUEUE_CLASSES; c++)
+  {
+    if (!ringIsEmpty(&rings[c]))
+      return false;
+  }
+
+  return true;
+}
+
+uint8_t evqCount(void)
+{
+  uint8_t count = 0;
+
+  for (uint8_t c = 0; c < QUEUE_CLASSES; c++)
+    count += (uint8_t)(rings[c].head - rings[c].tail);
+
+  return count;
+}
+
+/* True when a class ring is full, its next message would be dropped */
+bool evqIsFull(void)
+{
+  for (uint8_t c = 0; c < QUEUE_CLASSES; c++)
+  {
+    if (ringIsFull(&rings[c]))
+      return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,27 @@
+#ifndef EVQUEUE_H
+#define EVQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "definitions.h"
+
+/* Queue messages, a button event tagged with its intersection */
+#define EVQ_MSG(id, event) ((uint8_t)(((id) << 3) | (event)))
+#define EVQ_ID(msg)        ((msg) >> 3)
+#define EVQ_EVENT(msg)     ((msg) & 0x07)
+
+/* Event of the phase timer expiry messages, never a buttons pad */
+#define EVQ_PHASE 7
+
+#if BUTTONS_PADS > EVQ_PHASE
+#error "BUTTONS_PADS overlaps EVQ_PHASE"
+#endif
+
+void evqInit(void);
+bool evqPut(uint8_t msg);
+bool evqGet(uint8_t *msgp);
+bool evqIsEmpty(void);
+bool evqIsFull(void);
+uint8_t evqCount(void);
+
+#endif
@@ -0,0 +1,62 @@
+/* Generated by tools/intersection.py from intersection.json, do not edit */
+
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+/* Lamps wiring, pad and port group of each one */
+#define LED_VERDE_PRINCIPAL     0 // PB0
+#define LED_AMARELO_PRINCIPAL   7 // PD7
+#define LED_VERMELHO_PRINCIPAL  6 // PD6
+#define LED_VERDE_SECUNDARIA    5 // PD5
+#define LED_AMARELO_SECUNDARIA  4 // PD4
+#define LED_VERMELHO_SECUNDARIA 3 // PD3
+#define LED_VERMELHO_PEDESTRE   0 // PC0
+#define LED_VERDE_PEDESTRE      1 // PC1
+
+#define LED_VERDE_PRINCIPAL_PORT     LAMP_PORT_B
+#define LED_AMARELO_PRINCIPAL_PORT   LAMP_PORT_D
+#define LED_VERMELHO_PRINCIPAL_PORT  LAMP_PORT_D
+#define LED_VERDE_SECUNDARIA_PORT    LAMP_PORT_D
+#define LED_AMARELO_SECUNDARIA_PORT  LAMP_PORT_D
+#define LED_VERMELHO_SECUNDARIA_PORT LAMP_PORT_D
+#define LED_VERMELHO_PEDESTRE_PORT   LAMP_PORT_C
+#define LED_VERDE_PEDESTRE_PORT      LAMP_PORT_C
+
+/* Timings, milliseconds */
+#define TIMING_VERDE_PRINCIPAL_MS    10000
+#define TIMING_VERDE_SECUNDARIA_MS   6000
+#define TIMING_VERDE_PREEMPTADO_MS   5000
+#define TIMING_AMARELO_MS            2000
+#define TIMING_TRAVESSIA_MS          3000
+#define TIMING_PISCA_MS              2000
+#define TIMING_PISCA_MEIO_PERIODO_MS 500
+
+/* Phases, the row index of the transition table, the cycle starts on
+   the first one */
+typedef enum
+{
+  PH_PRINCIPAL_VERDE = 0,
+  PH_PRINCIPAL_AMARELO,
+  PH_SECUNDARIA_VERDE,
+  PH_SECUNDARIA_AMARELO,
+  PH_PEDESTRE_VERDE_P,    // Pedestrian crossing entered from the main avenue
+  PH_PEDESTRE_PISCA_P,
+  PH_PEDESTRE_VERDE_S,    // Pedestrian crossing entered from the secondary avenue
+  PH_PEDESTRE_PISCA_S,
+  PH_COUNT
+} phase_t;
+
+#define PH_INITIAL PH_PRINCIPAL_VERDE
+
+/* Phase names, initializer of a const char *[PH_COUNT] for the host tools */
+#define PH_NAMES \
+  "PRINCIPAL_VERDE", \
+  "PRINCIPAL_AMARELO", \
+  "SECUNDARIA_VERDE", \
+  "SECUNDARIA_AMARELO", \
+  "PEDESTRE_VERDE_P", \
+  "PEDESTRE_PISCA_P", \
+  "PEDESTRE_VERDE_S", \
+  "PEDESTRE_PISCA_S"
+
+#endif
@@ -0,0 +1,83 @@
+/* Generated by tools/intersection.py from intersection.json, do not edit.
+   Included by controller.c only. */
+
+static const phase_desc_t phases[PH_COUNT] ROM =
+{
+  [PH_PRINCIPAL_VERDE]    = {LAMP_VERDE_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             0, TIMING_VERDE_PRINCIPAL_MS, TIMING_VERDE_PREEMPTADO_MS, REQ_AMB_SEC, 0, 0},
+  [PH_PRINCIPAL_AMARELO]  = {LAMP_AMARELO_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             0, TIMING_AMARELO_MS, TIMING_AMARELO_MS, 0, 0, 0},
+  [PH_SECUNDARIA_VERDE]   = {LAMP_VERMELHO_PRINCIPAL | LAMP_VERDE_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             0, TIMING_VERDE_SECUNDARIA_MS, TIMING_VERDE_PREEMPTADO_MS, REQ_AMB_PRI, REQ_CARRO, 0},
+  [PH_SECUNDARIA_AMARELO] = {LAMP_VERMELHO_PRINCIPAL | LAMP_AMARELO_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             0, TIMING_AMARELO_MS, TIMING_AMARELO_MS, 0, 0, 0},
+  [PH_PEDESTRE_VERDE_P]   = {LAMP_VERMELHO_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERDE_PEDESTRE,
+                             0, TIMING_TRAVESSIA_MS, TIMING_TRAVESSIA_MS, 0, REQ_PEDESTRE, 0},
+  [PH_PEDESTRE_PISCA_P]   = {LAMP_VERMELHO_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             LAMP_VERMELHO_PEDESTRE, TIMING_PISCA_MS, TIMING_PISCA_MS, 0, 0, TIMING_PISCA_MEIO_PERIODO_MS},
+  [PH_PEDESTRE_VERDE_S]   = {LAMP_VERMELHO_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERDE_PEDESTRE,
+                             0, TIMING_TRAVESSIA_MS, TIMING_TRAVESSIA_MS, 0, REQ_PEDESTRE, 0},
+  [PH_PEDESTRE_PISCA_S]   = {LAMP_VERMELHO_PRINCIPAL | LAMP_VERMELHO_SECUNDARIA | LAMP_VERMELHO_PEDESTRE,
+                             LAMP_VERMELHO_PEDESTRE, TIMING_PISCA_MS, TIMING_PISCA_MS, 0, 0, TIMING_PISCA_MEIO_PERIODO_MS},
+};
+
+/* Next phase of each phase, indexed by the pending REQ_* mask */
+static const uint8_t transitions[PH_COUNT][REQ_COUNT] ROM =
+{
+  [PH_PRINCIPAL_VERDE] =
+  {
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_AMARELO, PH_PRINCIPAL_AMARELO, PH_PRINCIPAL_AMARELO,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+    PH_PRINCIPAL_AMARELO, PH_PRINCIPAL_AMARELO, PH_PRINCIPAL_AMARELO, PH_PRINCIPAL_AMARELO,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+  },
+  [PH_PRINCIPAL_AMARELO] =
+  {
+    PH_PRINCIPAL_VERDE, PH_PEDESTRE_VERDE_P, PH_SECUNDARIA_VERDE, PH_PEDESTRE_VERDE_P,
+    PH_PRINCIPAL_VERDE, PH_PEDESTRE_VERDE_P, PH_SECUNDARIA_VERDE, PH_PEDESTRE_VERDE_P,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+  },
+  [PH_SECUNDARIA_VERDE] =
+  {
+    PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO,
+    PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO, PH_SECUNDARIA_AMARELO,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+  },
+  [PH_SECUNDARIA_AMARELO] =
+  {
+    PH_PRINCIPAL_VERDE, PH_PEDESTRE_VERDE_S, PH_PRINCIPAL_VERDE, PH_PEDESTRE_VERDE_S,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+  },
+  [PH_PEDESTRE_VERDE_P] =
+  {
+    PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P,
+    PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P,
+    PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P,
+    PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P, PH_PEDESTRE_PISCA_P,
+  },
+  [PH_PEDESTRE_PISCA_P] =
+  {
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+  },
+  [PH_PEDESTRE_VERDE_S] =
+  {
+    PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S,
+    PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S,
+    PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S,
+    PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S, PH_PEDESTRE_PISCA_S,
+  },
+  [PH_PEDESTRE_PISCA_S] =
+  {
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+    PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE, PH_PRINCIPAL_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+    PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE, PH_SECUNDARIA_VERDE,
+  },
+};
@@ -0,0 +1,86 @@
+/*
+  * Signal heads output, maps the controller LAMP_* bits to the PAL pads.
+  * Only the PAL API is used so the same code drives the board and the
+  * simulated PAL of the host build.
+  *
+  * The pads image of every port group is looked up in tables generated at
+  * compile time from the wiring in intersection.json, a lamps change is then
+  * one masked write per port and the signal heads never show a mix of the
+  * old and the new phase.
+*/
+
+#include "hal.h"
+#include "lamps.h"
+#include "rom.h"
+
+/* Pad bit of a lamp if it is lit in lamps and wired on the port group */
+#define LAMP_PAD(lamps, port, lamp, led)                                   \
+  ((((lamps) & (lamp)) != 0 && led##_PORT == (port)) ? PAL_PORT_BIT(led) : 0)
+
+#define LAMPS_IMAGE(lamps, port)                                           \
+  (LAMP_PAD(lamps, port, LAMP_VERDE_PRINCIPAL, LED_VERDE_PRINCIPAL) |       \
+   LAMP_PAD(lamps, port, LAMP_AMARELO_PRINCIPAL, LED_AMARELO_PRINCIPAL) |   \
+   LAMP_PAD(lamps, port, LAMP_VERMELHO_PRINCIPAL, LED_VERMELHO_PRINCIPAL) | \
+   LAMP_PAD(lamps, port, LAMP_VERDE_SECUNDARIA, LED_VERDE_SECUNDARIA) |     \
+   LAMP_PAD(lamps, port, LAMP_AMARELO_SECUNDARIA, LED_AMARELO_SECUNDARIA) | \
+   LAMP_PAD(lamps, port, LAMP_VERMELHO_SECUNDARIA, LED_VERMELHO_SECUNDARIA) | \
+   LAMP_PAD(lamps, port, LAMP_VERMELHO_PEDESTRE, LED_VERMELHO_PEDESTRE) |   \
+   LAMP_PAD(lamps, port, LAMP_VERDE_PEDESTRE, LED_VERDE_PEDESTRE))
+
+#define IMAGE_ROW(port, shift)                                             \
+  {LAMPS_IMAGE(0 << (shift), port),  LAMPS_IMAGE(1 << (shift), port),       \
+   LAMPS_IMAGE(2 << (shift), port),  LAMPS_IMAGE(3 << (shift), port),       \
+   LAMPS_IMAGE(4 << (shift), port),  LAMPS_IMAGE(5 << (shift), port),       \
+   LAMPS_IMAGE(6 << (shift), port),  LAMPS_IMAGE(7 << (shift), port),       \
+   LAMPS_IMAGE(8 << (shift), port),  LAMPS_IMAGE(9 << (shift), port),       \
+   LAMPS_IMAGE(10 << (shift), port), LAMPS_IMAGE(11 << (shift), port),      \
+   LAMPS_IMAGE(12 << (shift), port), LAMPS_IMAGE(13 << (shift), port),      \
+   LAMPS_IMAGE(14 << (shift), port), LAMPS_IMAGE(15 << (shift), port)}
+
+#define PORT_IMAGES(port) {IMAGE_ROW(port, 0), IMAGE_ROW(port, 4)}
+
+const lamp_lut_t lamps_board_lut ROM =
+{
+  .mask  = {LAMPS_IMAGE(0xFF, LAMP_PORT_B), LAMPS_IMAGE(0xFF, LAMP_PORT_C),
+            LAMPS_IMAGE(0xFF, LAMP_PORT_D)},
+  .image = {PORT_IMAGES(LAMP_PORT_B), PORT_IMAGES(LAMP_PORT_C),
+            PORT_IMAGES(LAMP_PORT_D)}
+};
+
+/* Signal heads wiring of the board, see intersection.json */
+const lamp_map_t lamps_board =
+{
+  .port = {LAMPS_BOARD_PORTS},
+  .lut  = &lamps_board_lut
+};
+
+void lampsInit(const lamp_map_t *map)
+{
+  for (uint8_t p = 0; p < LAMP_PORTS; p++)
+  {
+    uint8_t mask = rom_byte(&map->lut->mask[p]);
+
+    for (uint8_t pad = 0; pad < 8; pad++)
+    {
+      if (mask & PAL_PORT_BIT(pad))
+        palSetPadMode(map->port[p], pad, PAL_MODE_OUTPUT_PUSHPULL);
+    }
+  }
+
+  lampsWrite(map, 0);
+}
+
+/*
+  * Read-modify-write of each port, other threads writing pads of the same
+  * ports must be excluded by the caller.
+*/
+void lampsWrite(const lamp_map_t *map, uint8_t lamps)
+{
+  for (uint8_t p = 0; p < LAMP_PORTS; p++)
+  {
+    uint8_t image = rom_byte(&map->lut->image[p][0][lamps & 0x0F]) |
+                    rom_byte(&map->lut->image[p][1][lamps >> 4]);
+
+    palWriteGroup(map->port[p], rom_byte(&map->lut->mask[p]), 0, image);
+  }
+}
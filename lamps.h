@@ -0,0 +1,61 @@
+#ifndef LAMPS_H
+#define LAMPS_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "controller.h"
+#include "rom.h"
+
+/*
+  * Pads images of the signal heads, for each port group the pads driven by
+  * the lamps and the image of the pads for each half of the LAMP_* mask.
+*/
+typedef struct
+{
+  uint8_t mask[LAMP_PORTS];
+  uint8_t image[LAMP_PORTS][2][16];
+} lamp_lut_t;
+
+/* Signal heads wiring, the ports of each group and their images (flash) */
+typedef struct
+{
+  ioportid_t port[LAMP_PORTS];
+  const lamp_lut_t *lut;
+} lamp_map_t;
+
+/* Ports of the board signal heads, one per LAMP_PORT_* group */
+#define LAMPS_BOARD_PORTS IOPORT2, IOPORT3, IOPORT4
+
+extern const lamp_lut_t lamps_board_lut;
+extern const lamp_map_t lamps_board;
+
+void lampsInit(const lamp_map_t *map);
+void lampsWrite(const lamp_map_t *map, uint8_t lamps);
+
+/*
+  * lampsWrite() specialised at compile time for a constant wiring. The ports
+  * and the tables are constants, so on AVR every port access is a direct
+  * I/O instruction instead of a load through the map. The PAL of hal.h is
+  * the I/O policy: the board one or the simulated one of the host build.
+  * LAMPS_WRITER(name, lut, ports...) defines static inline name(lamps).
+*/
+#if LAMP_PORTS != 3
+#error "LAMPS_WRITER writes three port groups"
+#endif
+
+#define LAMPS_WRITE_GROUP(lut, p, port, lamps)                             \
+  palWriteGroup(port, rom_byte(&(lut).mask[p]), 0,                         \
+                rom_byte(&(lut).image[p][0][(lamps) & 0x0F]) |             \
+                rom_byte(&(lut).image[p][1][(lamps) >> 4]))
+
+#define LAMPS_WRITER_(name, lut, port_b, port_c, port_d)                   \
+  static inline void name(uint8_t lamps)                                   \
+  {                                                                        \
+    LAMPS_WRITE_GROUP(lut, LAMP_PORT_B, port_b, lamps);                    \
+    LAMPS_WRITE_GROUP(lut, LAMP_PORT_C, port_c, lamps);                    \
+    LAMPS_WRITE_GROUP(lut, LAMP_PORT_D, port_d, lamps);                    \
+  }
+
+#define LAMPS_WRITER(name, lut, ...) LAMPS_WRITER_(name, lut, __VA_ARGS__)
+
+#endif
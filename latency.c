@@ -0,0 +1,112 @@
+/*
+  * Press-to-green latency histograms.
+  *
+  * A request is timed from the press that made it pending to the next time
+  * the green serving it lights up. The ambulances hold their green, when it
+  * is already lit the latency is the press collection time. Times are ticks
+  * of the caller clock, free running 32 bits so only their differences are
+  * used. No dependency on ChibiOS, the caller provides the clock and the
+  * locking.
+*/
+
+#include "latency.h"
+#include "rom.h"
+
+/* Green lamp serving each request class */
+static const uint8_t lat_green[LAT_CLASSES] ROM =
+{
+  LAMP_VERDE_PEDESTRE,   // REQ_PEDESTRE
+  LAMP_VERDE_SECUNDARIA, // REQ_CARRO
+  LAMP_VERDE_PRINCIPAL,  // REQ_AMB_PRI
+  LAMP_VERDE_SECUNDARIA, // REQ_AMB_SEC
+};
+
+/* Requests keeping their green as long as they are pending */
+#define LAT_HOLD (REQ_AMB_PRI | REQ_AMB_SEC)
+
+static uint32_t latMs(const latency_t *lp, uint32_t ticks)
+{
+  if (ticks <= UINT32_MAX / 1000U)
+    return ticks * 1000U / lp->tick_hz;
+  return ticks / lp->tick_hz * 1000U;
+}
+
+static void latRecord(latency_t *lp, uint8_t c, uint32_t ticks)
+{
+  lat_hist_t *hp = &lp->hist[c];
+  uint32_t ms = latMs(lp, ticks);
+  uint8_t b = 0;
+
+  while (ms >> b && b < LAT_BUCKETS - 1)
+    b++;
+
+  if (hp->count[b] < UINT16_MAX)
+    hp->count[b]++;
+  if (ms > hp->max_ms)
+    hp->max_ms = ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+}
+
+void latInit(latency_t *lp, uint16_t tick_hz)
+{
+  lp->tick_hz = tick_hz;
+  lp->timing = 0;
+  lp->lamps = 0;
+  latClear(lp);
+}
+
+void latClear(latency_t *lp)
+{
+  for (uint8_t c = 0; c < LAT_CLASSES; c++)
+  {
+    for (uint8_t b = 0; b < LAT_BUCKETS; b++)
+      lp->hist[c].count[b] = 0;
+    lp->hist[c].max_ms = 0;
+  }
+}
+
+/* Called with the pending requests before and after a press is collected */
+void latRequests(latency_t *lp, uint8_t before, uint8_t after,
+                 uint32_t pressed, uint32_t now)
+{
+  uint8_t started = after & ~before;
+
+  /* An ambulance request toggled off is not waiting anymore */
+  lp->timing &= after;
+
+  for (uint8_t c = 0; c < LAT_CLASSES; c++)
+  {
+    uint8_t bit = 1 << c;
+
+    if ((started & bit) == 0)
+      continue;
+
+    if ((bit & LAT_HOLD) && (lp->lamps & rom_byte(&lat_green[c])))
+      latRecord(lp, c, now - pressed);
+    else
+    {
+      lp->since[c] = pressed;
+      lp->timing |= bit;
+    }
+  }
+}
+
+/* Called with the lamps written on the signal heads */
+void latLamps(latency_t *lp, uint8_t lamps, uint32_t now)
+{
+  uint8_t lit = lamps & ~lp->lamps;
+
+  lp->lamps = lamps;
+  if (lit == 0)
+    return;
+
+  for (uint8_t c = 0; c < LAT_CLASSES; c++)
+  {
+    uint8_t bit = 1 << c;
+
+    if ((lp->timing & bit) && (lit & rom_byte(&lat_green[c])))
+    {
+      latRecord(lp, c, now - lp->since[c]);
+      lp->timing &= ~bit;
+    }
+  }
+}
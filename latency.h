@@ -0,0 +1,36 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "controller.h"
+
+/*
+  * Press-to-green latency histograms, one per request class (REQ_* bit).
+  * Bucket 0 counts latencies under 1 ms, bucket b the latencies in
+  * [2^(b-1), 2^b) ms, the last one everything from 2^(LAT_BUCKETS-2) ms.
+*/
+#define LAT_CLASSES 4
+#define LAT_BUCKETS 17
+
+typedef struct
+{
+  uint16_t count[LAT_BUCKETS]; // Saturating
+  uint16_t max_ms;             // Saturating
+} lat_hist_t;
+
+typedef struct
+{
+  lat_hist_t hist[LAT_CLASSES];
+  uint32_t since[LAT_CLASSES]; // Press of each class being timed, in ticks
+  uint16_t tick_hz;            // Ticks frequency of the caller clock
+  uint8_t timing;              // REQ_* waiting for their green
+  uint8_t lamps;               // Lamps at the last latLamps()
+} latency_t;
+
+void latInit(latency_t *lp, uint16_t tick_hz);
+void latClear(latency_t *lp);
+void latRequests(latency_t *lp, uint8_t before, uint8_t after,
+                 uint32_t pressed, uint32_t now);
+void latLamps(latency_t *lp, uint8_t lamps, uint32_t now);
+
+#endif
@@ -19,199 +19,284 @@
 #include <string.h>
 #include <stdio.h>
 #include "definitions.h"
+#include "controller.h"
+#include "lamps.h"
+#include "evqueue.h"
+#include "latency.h"
+#include "engine.h"
+#include "telemetry.h"
+#include "stackmon.h"
+
+#if defined(COLLECT_TIMEOUT_MS)
+#define COLLECT_TIMEOUT TIME_MS2I(COLLECT_TIMEOUT_MS)
+#else
+#define COLLECT_TIMEOUT TIME_INFINITE
+#endif
 
 /*
   * Global Variables
 */ 
-static msg_t queue[QUEUE_SIZE], *rdp, *wrp;
-static size_t qsize;
-static mutex_t qmtx;
-static condition_variable_t qempty, qfull;
-static virtual_timer_t vt;
-uint8_t EVENT = 0, BACKUP_EVENT = 0;
-state_via_t STATE = PRINCIPAL;
-state_LED_t LED_PRINCIPAL = VERDE, LED_SECUNDARIA = VERMELHO, LED_PEDESTRE = VERMELHO;
-uint32_t counter = 0;
-uint8_t amb_sec = 0x00, amb_pri = 0x00, ped_sec = 0x00, flag = 0x00;
+static thread_reference_t qwaiter = NULL;
+static uint8_t buttons_last = BUTTONS_MASK;
+static systimestamp_t buttons_edge[BUTTONS_PADS];
+static thread_t *process_tp;
+static thread_t *main_tp;
+
+/* Intersections, see engine.h. The histograms are updated out of the kernel
+   lock by the collector and Process Event, equal priority threads that never
+   preempt each other without a time quantum, the serial monitor reads them
+   locked.*/
+#if CH_CFG_TIME_QUANTUM != 0
+#error "the latency histograms need CH_CFG_TIME_QUANTUM 0"
+#endif
+
+/* One event flag per intersection, eventmask_t is 8 bits wide on AVR */
+#if INTERSECTIONS > 8
+#error "INTERSECTIONS exceeds the Process Event flags"
+#endif
+
+/* The event loop shares the main thread flags with the serial monitor */
+#if defined(EVENT_LOOP) && INTERSECTIONS > 5
+#error "INTERSECTIONS exceeds the event loop flags"
+#endif
+
+static intersection_t intersections[INTERSECTIONS];
+
+/* Signal heads of each intersection, one map per intersection */
+static const lamp_map_t * const intersections_lamps[] =
+{
+  &lamps_board
+};
+
+_Static_assert(sizeof(intersections_lamps) / sizeof(intersections_lamps[0]) == INTERSECTIONS,
+               "intersections_lamps needs one lamp map per intersection");
+
+#if INTERSECTIONS == 1
+/* A single intersection is the board wiring, written with constant ports */
+LAMPS_WRITER(BoardLampsWrite, lamps_board_lut, LAMPS_BOARD_PORTS)
+#endif
 
 /*
   * Global Functions
 */
 void InitBuffer(void);
-void PushBUffer(msg_t msg);
+void PushBUffer(uint8_t msg);
+bool PushBUfferI(uint8_t msg);
 uint8_t PopBUffer(void);
+msg_t PopBUfferTimeout(sysinterval_t timeout);
 int IsBUfferEmpty(void);
 int IsBufferFull(void);
 
-/* Virtual Timer */
-static void Avenida_Principal_Sinal_Verde(void *arg);
-static void Avenida_Principal_Sinal_Amarelo(void *arg);
+/* Lamps update request of an intersection, posted from the collector to
+   Process Event */
+#define EVT_LAMPS(id) EVENT_MASK(id)
+
+/* Main thread events, the serial monitor and, with EVENT_LOOP, the event
+   queue */
+#define EVT_QUEUE     EVENT_MASK(5)
+#define EVT_SERIAL    EVENT_MASK(6)
+#define EVT_TELEMETRY EVENT_MASK(7)
+
+/* Events handlers, run by the threads or by the event loop */
+static void CollectEvent(uint8_t msg);
+static void ProcessLamps(eventmask_t pending);
+static void Monitor(eventmask_t pending, event_listener_t *elp);
+
+/* Serial monitor */
+static void TelemetryFlush(void);
+static bool ReportFlush(void);
+static void LatencyDump(void);
+static void LatencyClear(void);
+#if defined(IRQ_PROBE)
+static void IrqProbeStart(void);
+static void IrqProbeDump(void);
+static void IrqProbeClear(void);
+#endif
+#if defined(IDLE_REPORT)
+static void IdleDump(void);
+static void IdleClear(void);
+#endif
+#if defined(STACK_REPORT)
+/* Idle thread working area, static in the kernel, bounds from its config */
+#define IDLE_WA_BASE ((uint8_t *)ch_core0_cfg.idlethread_base)
+#define IDLE_WA_SIZE ((uint16_t)((uint8_t *)ch_core0_cfg.idlethread_end -  \
+                                 IDLE_WA_BASE))
+
+static void StackReport(void);
+#endif
+#if defined(CYCLE_BENCH)
+static void CycleBench(void);
+#endif
 
-static void Avenida_Secundaria_Sinal_Verde(void *arg);
-static void Avenida_Secundaria_Sinal_Amarelo(void *arg);
+/*
+  * Buttons Pin Change Interrupt (PB1..PB4 -> PCINT1..PCINT4)
+*/
+CH_IRQ_HANDLER(PCINT0_vect)
+{
+  uint8_t pins, changed;
+  systimestamp_t now;
 
-static void Via_Pedestre_Sinal_Verde(void *arg);
-static void Via_Pedestre_Sinal_Amarelo(void *arg);
+  CH_IRQ_PROLOGUE();
 
-/* 
-  * Thread Write Event 
+  pins = palReadPort(IOPORT2) & BUTTONS_MASK;
+  changed = pins ^ buttons_last;
+  buttons_last = pins;
+
+  if (changed)
+  {
+    chSysLockFromISR();
+    now = chVTGetTimeStampI();
+    for (uint8_t pad = 0; pad < BUTTONS_PADS; pad++)
+    {
+      if ((changed & PAL_PORT_BIT(pad)) == 0)
+        continue;
+
+      /* A press is a falling edge after the pin has been stable for the
+         debounce window, bounces on press and release are discarded.*/
+      if ((pins & PAL_PORT_BIT(pad)) == 0 &&
+          now - buttons_edge[pad] >= TIME_MS2I(DEBOUNCE_MS))
+        engPressI(&intersections[BUTTON_INTERSECTION(pad)], pad, now);
+
+      buttons_edge[pad] = now;
+    }
+    chSysUnlockFromISR();
+  }
+
+  CH_IRQ_EPILOGUE();
+}
+
+/*
+  * Events handlers
 */
-static THD_WORKING_AREA(wa_WriteEvent, 128);
-static THD_FUNCTION(Write_Save_Event, arg)
+static void CollectEvent(uint8_t msg)
 {
-  chRegSetThreadName("Save/Write Event");
-  while (1)
-  {
-    if (palReadPad(IOPORT2, PEDESTRE) == PAL_LOW)
-      PushBUffer(PEDESTRE);
+  if (EVQ_ID(msg) >= INTERSECTIONS)
+    return;
+
+  /* The LED blinks on the collected presses */
+  if (EVQ_EVENT(msg) != EVQ_PHASE)
+    palTogglePad(IOPORT2, PORTB_LED1);
+
+  engCollect(&intersections[EVQ_ID(msg)], EVQ_EVENT(msg));
+}
 
-    if (palReadPad(IOPORT2, CARRO_SECUNDARIA) == PAL_LOW)
-      PushBUffer(CARRO_SECUNDARIA);
+static void ProcessLamps(eventmask_t pending)
+{
+  for (uint8_t i = 0; i < INTERSECTIONS; i++)
+  {
+    intersection_t *isp = &intersections[i];
+    systimestamp_t now;
+    uint8_t lamps;
+
+    if ((pending & EVT_LAMPS(i)) == 0)
+      continue;
+
+    /* Locked, PORTB is shared with the LED toggled by the collector */
+    chSysLock();
+    lamps = isp->ctl.lamps;
+#if INTERSECTIONS == 1
+    BoardLampsWrite(lamps);
+#else
+    lampsWrite(isp->lamps, lamps);
+#endif
+    now = chVTGetTimeStampI();
+    chSysUnlock();
+
+    latLamps(&isp->lat, lamps, (uint32_t)now);
+  }
+}
 
-    if (palReadPad(IOPORT2, AMBULANCIA_PRINCIPAL) == PAL_LOW)
-      PushBUffer(AMBULANCIA_PRINCIPAL);
+static void Monitor(eventmask_t pending, event_listener_t *elp)
+{
+  msg_t cmd;
 
-    if (palReadPad(IOPORT2, AMBULANCIA_SECUNDARIA) == PAL_LOW)
-      PushBUffer(AMBULANCIA_SECUNDARIA);
+  if ((pending & (EVT_TELEMETRY | EVT_SERIAL)) == 0)
+    return;
 
-    /* Debouce Delay */
-    chThdSleepMilliseconds(150);
+  chEvtGetAndClearFlags(elp);
+  while ((cmd = sdGetTimeout(&SD1, TIME_IMMEDIATE)) >= 0)
+  {
+    if (cmd == 'h')
+      LatencyDump();
+    else if (cmd == 'r')
+    {
+      LatencyClear();
+#if defined(IRQ_PROBE)
+      IrqProbeClear();
+#endif
+#if defined(IDLE_REPORT)
+      IdleClear();
+#endif
+    }
+#if defined(IRQ_PROBE)
+    else if (cmd == 'i')
+      IrqProbeDump();
+#endif
+#if defined(IDLE_REPORT)
+    else if (cmd == 'p')
+      IdleDump();
+#endif
+#if defined(STACK_REPORT)
+    else if (cmd == 's')
+      StackReport();
+#endif
   }
+
+  if (!ReportFlush())
+    TelemetryFlush();
 }
 
+#if !defined(EVENT_LOOP)
 /* 
   * Thread Read Event
 */
-static THD_WORKING_AREA(wa_ReadEvent, 128);
+static THD_WORKING_AREA(wa_ReadEvent, WA_READ_EVENT_SIZE);
 static THD_FUNCTION(Read_Collect_Event, arg)
 {
   chRegSetThreadName("Read/Collect Event");
   while (1)
   {
-    if (!IsBUfferEmpty())
-    {
-      palTogglePad(IOPORT2, PORTB_LED1);
-      BACKUP_EVENT = EVENT;
-      EVENT = PopBUffer();
-
-      if (EVENT == AMBULANCIA_PRINCIPAL)
-        amb_pri ^= 1;
-      if (EVENT == AMBULANCIA_SECUNDARIA)
-        amb_sec ^= 1;        
-    }
+    /* Sleeping until an event is available, the timeout only wakes the
+       thread up when COLLECT_TIMEOUT_MS is configured for housekeeping.*/
+    msg_t msg = PopBUfferTimeout(COLLECT_TIMEOUT);
+    if (msg == MSG_TIMEOUT)
+      continue;
 
-    chThdSleepMilliseconds(1);
+    CollectEvent((uint8_t)msg);
   }
 }
 
 /* 
   * Thread Process Event 
 */
-static THD_WORKING_AREA(wa_ProcessEvent, 128);
+static THD_WORKING_AREA(wa_ProcessEvent, WA_PROCESS_EVENT_SIZE);
 static THD_FUNCTION(ProcessEvent, arg)
 {
   chRegSetThreadName("Process Event");
   while (1)
   {
-    switch (STATE)
-    {
-      case IDLE_ST:
-        break;
-    
-      case PRINCIPAL:
-      {
-        switch (LED_PRINCIPAL)
-        {
-          case VERDE:
-          {
-            palSetPad(IOPORT2, LED_VERDE_PRINCIPAL);
-            palClearPad(IOPORT4, LED_AMARELO_PRINCIPAL);
-            palClearPad(IOPORT4, LED_VERMELHO_PRINCIPAL);
-            chVTSet(&vt, TIME_MS2I(1000), Avenida_Principal_Sinal_Verde, (void*)&vt);
-            break;
-          }
-      
-          case AMARELO:
-          {
-            palClearPad(IOPORT2, LED_VERDE_PRINCIPAL);
-            palClearPad(IOPORT4, LED_VERMELHO_PRINCIPAL);
-            palSetPad(IOPORT4, LED_AMARELO_PRINCIPAL);
-            chVTSet(&vt, TIME_MS2I(1000), Avenida_Principal_Sinal_Amarelo, (void*)&vt);
-            break;
-          }
-        }
-        
-        STATE = IDLE_ST;
-        break;
-      }
-      
-      case SECUNDARIA:
-      {
-        switch (LED_SECUNDARIA)
-        {
-          case VERDE:
-          {
-            palSetPad(IOPORT4, LED_VERDE_SECUNDARIA);
-            palClearPad(IOPORT4, LED_AMARELO_SECUNDARIA);
-            palClearPad(IOPORT4, LED_VERMELHO_SECUNDARIA);
-            chVTSet(&vt, TIME_MS2I(1000), Avenida_Secundaria_Sinal_Verde, (void*)&vt);
-            break;
-          }
-          
-          case AMARELO:
-          {
-            palClearPad(IOPORT4, LED_VERDE_SECUNDARIA);
-            palSetPad(IOPORT4, LED_AMARELO_SECUNDARIA);
-            palClearPad(IOPORT4, LED_VERMELHO_SECUNDARIA);
-            chVTSet(&vt, TIME_MS2I(1000), Avenida_Secundaria_Sinal_Amarelo, (void*)&vt);
-            break;
-          }
-        }
-
-        STATE = IDLE_ST;
-        break;
-      }
-      
-      case _PEDESTRE:
-      {
-        switch (LED_PEDESTRE)
-        {
-          case VERDE:
-          {
-            palSetPad(IOPORT3, LED_VERDE_PEDESTRE);
-            palClearPad(IOPORT3, LED_VERMELHO_PEDESTRE);
-            chVTSet(&vt, TIME_MS2I(1000), Via_Pedestre_Sinal_Verde, (void*)&vt);
-            break;
-          }
-
-          case AMARELO:
-          {
-            palClearPad(IOPORT3, LED_VERDE_PEDESTRE);
-            palSetPad(IOPORT3, LED_VERMELHO_PEDESTRE);
-            chVTSet(&vt, TIME_MS2I(1000 / 2), Via_Pedestre_Sinal_Amarelo, (void*)&vt);
-            break;
-          }
-        }
-
-        STATE = IDLE_ST;
-        break;
-      }
-    }
-
-    chThdSleepMilliseconds(1);
+    /* Sleeping until the collector changes the lamps.*/
+    ProcessLamps(chEvtWaitAny(ALL_EVENTS));
   }
 }
+#endif
 
 /*
  * Application entry point.
  */
 int main(void) 
 {
-  thread_t *thd0 = 0, *thd1 = 0, *thd2 = 0;
+  event_listener_t serial_listener;
   SerialConfig Serial_Configuration = {.sc_brr = UBRR2x(115200), .sc_bits_per_char = USART_CHAR_SIZE_8};
 
+#if defined(STACK_REPORT)
+  stkPaintMain();
+  stkPaint(IDLE_WA_BASE, IDLE_WA_SIZE);
+#endif
   InitBuffer();
-  chVTObjectInit(&vt);
+  tlmInit();
+  for (uint8_t i = 0; i < INTERSECTIONS; i++)
+    engInit(&intersections[i], i, intersections_lamps[i]);
   /*
    * System initializations.
    * - HAL initialization, this also initializes the configured device drivers
@@ -221,6 +306,10 @@ int main(void)
    */
   halInit();
   chSysInit();
+  main_tp = chThdGetSelfX();
+#if defined(IDLE_REPORT)
+  IdleClear();
+#endif
 
   sdStart(&SD1, &Serial_Configuration);
 
@@ -232,337 +321,727 @@ int main(void)
   palSetPadMode(IOPORT2, AMBULANCIA_PRINCIPAL, PAL_MODE_INPUT_PULLUP);
   palSetPadMode(IOPORT2, AMBULANCIA_SECUNDARIA, PAL_MODE_INPUT_PULLUP);  
 
-  /* LEDs main semaphore */
-  palSetPadMode(IOPORT2, LED_VERDE_PRINCIPAL, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT2, LED_VERDE_PRINCIPAL);
+  /* LEDs, lit by Process Event from the controller phase */
+  for (uint8_t i = 0; i < INTERSECTIONS; i++)
+    lampsInit(intersections[i].lamps);
+
+  /* Before the buttons interrupt, a press would be lost with the bench
+     state */
+#if defined(CYCLE_BENCH)
+  CycleBench();
+#endif
+
+  /* Buttons edges are captured by the pin change interrupt */
+  buttons_last = palReadPort(IOPORT2) & BUTTONS_MASK;
+  PCMSK0 = BUTTONS_MASK;
+  PCIFR = (1 << PCIF0);
+  PCICR |= (1 << PCIE0);
+
+  /* After the bench, both use TIMER2 */
+#if defined(IRQ_PROBE)
+  IrqProbeStart();
+#endif
+
+#if defined(EVENT_LOOP)
+  process_tp = main_tp;
+#else
+  chThdCreateStatic(wa_ReadEvent, sizeof(wa_ReadEvent), NORMALPRIO, Read_Collect_Event, NULL);
+  process_tp = chThdCreateStatic(wa_ProcessEvent, sizeof(wa_ProcessEvent), NORMALPRIO, ProcessEvent, NULL);
+#endif
+
+  /* Starting every cycle with the main avenue green, the collector arms
+     the first phase timers.*/
+  for (uint8_t i = 0; i < INTERSECTIONS; i++)
+  {
+    chEvtSignal(process_tp, EVT_LAMPS(i));
+    PushBUffer(EVQ_MSG(i, EVQ_PHASE));
+  }
 
-  palSetPadMode(IOPORT4, LED_AMARELO_PRINCIPAL, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT4, LED_AMARELO_PRINCIPAL);
+  /* The serial monitor wakes up on a command, on telemetry records and when
+     the output queue drains.*/
+  chEvtRegisterMaskWithFlags(chnGetEventSource(&SD1), &serial_listener,
+                             EVT_SERIAL, CHN_INPUT_AVAILABLE | CHN_OUTPUT_EMPTY);
 
-  palSetPadMode(IOPORT4, LED_VERMELHO_PRINCIPAL, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT4, LED_VERMELHO_PRINCIPAL);
+  chSysLock();
+  engTelemetryI(TLM_BOOT, 0, TLM_VERSION, CH_CFG_ST_FREQUENCY, chVTGetTimeStampI());
+  chSysUnlock();
 
-  /* LEDs Secondary semaphore */
-  palSetPadMode(IOPORT4, LED_VERDE_SECUNDARIA, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT4, LED_VERDE_SECUNDARIA);
+#if defined(EVENT_LOOP)
+  /* Event loop, the main thread runs all the handlers in the order of the
+     threads priorities and the idle thread puts the CPU to sleep between
+     events.*/
+  while (1)
+  {
+    eventmask_t pending = chEvtWaitAny(ALL_EVENTS);
+    uint8_t msg;
 
-  palSetPadMode(IOPORT4, LED_AMARELO_SECUNDARIA, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT4, LED_AMARELO_SECUNDARIA);
+    if (pending & EVT_QUEUE)
+    {
+      while (evqGet(&msg))
+        CollectEvent(msg);
+    }
+    ProcessLamps(pending);
+    Monitor(pending, &serial_listener);
+  }
+#else
+  /* Serial monitor, the main thread runs below the event threads so the
+     serial port never delays them and the idle thread puts the CPU to sleep
+     meanwhile.*/
+  chThdSetPriority(NORMALPRIO - 1);
+  while (1)
+    Monitor(chEvtWaitAny(EVT_TELEMETRY | EVT_SERIAL), &serial_listener);
+#endif
+}
 
-  palSetPadMode(IOPORT4, LED_VERMELHO_SECUNDARIA, PAL_MODE_OUTPUT_PUSHPULL);
-  palSetPad(IOPORT4, LED_VERMELHO_SECUNDARIA);
+/*
+  * Event queue, wraps the lock-free ring of evqueue.c with the consumer
+  * wake up.
+*/
+void InitBuffer()
+{
+  evqInit();
+}
 
-  /* LEDs Pedestrian semaphore */
-  palSetPadMode(IOPORT3, LED_VERMELHO_PEDESTRE, PAL_MODE_OUTPUT_PUSHPULL);
-  palSetPad(IOPORT3, LED_VERMELHO_PEDESTRE);
+bool PushBUfferI(uint8_t msg)
+{
+  /* The producer can run in ISR context so it never waits, a full queue
+     drops the message.*/
+  if (!evqPut(msg))
+    return false;
+
+  /* Waking up the consumer if it is waiting for a message.*/
+#if defined(EVENT_LOOP)
+  chEvtSignalI(main_tp, EVT_QUEUE);
+#else
+  chThdResumeI(&qwaiter, MSG_OK);
+#endif
+
+  return true;
+}
 
-  palSetPadMode(IOPORT3, LED_VERDE_PEDESTRE, PAL_MODE_OUTPUT_PUSHPULL);
-  palClearPad(IOPORT3, LED_VERDE_PEDESTRE);
+void PushBUffer(uint8_t msg)
+{
+  chSysLock();
+  (void)PushBUfferI(msg);
+  chSchRescheduleS();
+  chSysUnlock();
+}
 
-  thd0 = chThdCreateStatic(wa_WriteEvent, sizeof(wa_WriteEvent), NORMALPRIO, Write_Save_Event, NULL);
-  thd1 = chThdCreateStatic(wa_ReadEvent, sizeof(wa_ReadEvent), NORMALPRIO, Read_Collect_Event, NULL);
-  thd2 = chThdCreateStatic(wa_ProcessEvent, sizeof(wa_ProcessEvent), NORMALPRIO, ProcessEvent, NULL);
+msg_t PopBUfferTimeout(sysinterval_t timeout)
+{
+  uint8_t msg;
 
-  while (true) 
+  while (!evqGet(&msg))
   {
-    chThdSleepMilliseconds(1);
+    msg_t rdymsg = MSG_OK;
+
+    /* Checking again under lock so a push from the ISR cannot be lost
+       between the check and the suspension.*/
+    chSysLock();
+    if (evqIsEmpty())
+      rdymsg = chThdSuspendTimeoutS(&qwaiter, timeout);
+    chSysUnlock();
+
+    if (rdymsg != MSG_OK)
+      return MSG_TIMEOUT;
   }
+
+  return (msg_t)msg;
 }
 
-void InitBuffer()
+uint8_t PopBUffer()
 {
-  chMtxObjectInit(&qmtx);
-  chCondObjectInit(&qempty);
-  chCondObjectInit(&qfull);
- 
-  rdp = wrp = &queue[0];
-  qsize = 0;
+  return (uint8_t)PopBUfferTimeout(TIME_INFINITE);
 }
 
-void PushBUffer(msg_t msg)
+int IsBUfferEmpty()
 {
-  /* Entering monitor.*/
-  chMtxLock(&qmtx);
- 
-  /* Waiting for space in the queue.*/
-  while (IsBufferFull())
-    chCondWait(&qfull);
- 
-  /* Writing the message in the queue.*/  
-  *wrp = msg;
-  if (++wrp >= &queue[QUEUE_SIZE])
-    wrp = &queue[0];
-  qsize++;
-
-  /* Signaling that there is at least a message.*/
-  chCondSignal(&qempty);
+  return evqIsEmpty();
+}
 
-  /* Leaving monitor.*/
-  chMtxUnlock(&qmtx);
+int IsBufferFull()
+{
+  return evqIsFull();
 }
 
-uint8_t PopBUffer()
+/*
+  * Engine hooks, the engine posts its messages to the event queue and the
+  * lamps are written by Process Event.
+*/
+bool engPostI(uint8_t msg)
 {
-  msg_t msg;
- 
-  /* Entering monitor.*/
-  chMtxLock(&qmtx);
- 
-  /* Waiting for messages in the queue.*/
-  while (IsBUfferEmpty())
-    chCondWait(&qempty);
- 
-  /* Reading the message from the queue.*/  
-  msg = *rdp;
-  if (++rdp >= &queue[QUEUE_SIZE])
-    rdp = &queue[0];
-  qsize--;
- 
-  /* Signaling that there is at least one free slot.*/
-  chCondSignal(&qfull);
- 
-  /* Leaving monitor.*/
-  chMtxUnlock(&qmtx);
- 
-  return (uint8_t)msg;
+  return PushBUfferI(msg);
 }
 
-int IsBUfferEmpty()
+void engChangedI(intersection_t *isp, uint8_t changes)
 {
-  return qsize == 0;
+  if (changes & CTL_LAMPS_CHANGED)
+    chEvtSignalI(process_tp, EVT_LAMPS(isp->id));
 }
 
-int IsBufferFull()
+/*
+  * Telemetry, records are framed and written by the serial monitor. Called
+  * with the system locked, by the engine too, a full ring drops the record.
+*/
+void engTelemetryI(uint8_t type, uint8_t id, uint8_t a, uint16_t b,
+                   systimestamp_t now)
 {
-  return qsize >= QUEUE_SIZE;
+  if (tlmPutI(type, id, a, b, (uint32_t)now))
+    chEvtSignalI(main_tp, EVT_TELEMETRY);
 }
 
-/*====================== Avenida Principal ===============================*/
-static void Avenida_Principal_Sinal_Verde(void *arg)
+static size_t SerialRoom(void)
 {
-  chSysLockFromISR();
+  size_t room;
 
-  if (amb_pri == 0x00)
-  { 
-    counter++;
+  chSysLock();
+  room = oqGetEmptyI(&SD1.oqueue);
+  chSysUnlock();
 
-    if (counter >= 10 && (EVENT == PEDESTRE || EVENT == CARRO_SECUNDARIA))
-    {
-      counter = 0;
-      palClearPad(IOPORT2, LED_VERDE_PRINCIPAL);
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = AMARELO;
-      chVTReset((virtual_timer_t*)arg);
-    }
+  return room;
+}
 
-    if (counter >= 5 && amb_sec == 1)
-    {
-      counter = 0;
-      palClearPad(IOPORT2, LED_VERDE_PRINCIPAL);
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = AMARELO;
-      chVTReset((virtual_timer_t*)arg);
-    }
-  }
+static void TelemetryFlush(void)
+{
+  uint8_t frame[TLM_FRAME_SIZE];
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000), Avenida_Principal_Sinal_Verde, arg);
-  chSysUnlockFromISR();
+  /* Only the frames fitting in the output queue are written, the others
+     wait in the telemetry ring for the output queue to drain and the
+     monitor never blocks on the serial port.*/
+  while (SerialRoom() >= TLM_FRAME_SIZE && tlmGet(frame))
+    sdWrite(&SD1, frame, sizeof(frame));
 }
 
-static void Avenida_Principal_Sinal_Amarelo(void *arg)
+/*
+  * Monitor reports, written a field at a time as the output queue drains,
+  * the way the telemetry frames are: the monitor never blocks on the
+  * serial port, the report resumes on the next output empty event. The
+  * numbers are read when their field is written, not all at once.
+*/
+#define REPORT_FIELD_SIZE 14  // Longest field, the process_event name
+
+/* Text of a report line field, 0 past the last field of the line */
+typedef uint8_t (*report_field_t)(uint8_t line, uint8_t field, uint8_t *buf);
+
+static struct
 {
-  chSysLockFromISR();
-  
-  counter++;
+  report_field_t field_fn;  // NULL when no report is being written
+  uint8_t lines;
+  uint8_t line, field;
+} report;
 
-  if (counter >= 2)
+static uint8_t FieldNum(uint8_t *buf, uint32_t n)
+{
+  uint8_t digits[11];
+  uint8_t i = sizeof(digits);
+
+  digits[--i] = ' ';
+  do
   {
-    counter = 0;
-    palClearPad(IOPORT2, LED_VERDE_PRINCIPAL);
-    palClearPad(IOPORT4, LED_AMARELO_PRINCIPAL);
-    palSetPad(IOPORT4, LED_VERMELHO_PRINCIPAL);
-    
-    if (amb_sec == 1)
-    {
-      STATE = SECUNDARIA;
-      LED_SECUNDARIA = VERDE;
-    }
+    digits[--i] = '0' + n % 10;
+    n /= 10;
+  } while (n != 0);
 
-    else if (EVENT == PEDESTRE)
-    {
-      ped_sec |= (1 << 2);
-      STATE = _PEDESTRE;
-      LED_PEDESTRE = VERDE;
-    }
+  memcpy(buf, &digits[i], sizeof(digits) - i);
+  return sizeof(digits) - i;
+}
 
-    else if (EVENT == CARRO_SECUNDARIA)
-    {
-      if (BACKUP_EVENT == PEDESTRE)
-      {
-        ped_sec |= (1 << 2);
-        flag |= 1;
-        STATE = _PEDESTRE;
-        LED_PEDESTRE = VERDE;
-      }
-
-      else
-      {
-        STATE = SECUNDARIA;
-        LED_SECUNDARIA = VERDE;
-      }
-    }
+static uint8_t FieldText(uint8_t *buf, const char *text)
+{
+  uint8_t len = strlen(text);
 
-    EVENT = 0;
-    chVTReset((virtual_timer_t*)arg);
-  }
+  memcpy(buf, text, len);
+  return len;
+}
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000), Avenida_Principal_Sinal_Amarelo, arg);
-  chSysUnlockFromISR();
+static void ReportStart(report_field_t field_fn, uint8_t lines)
+{
+  /* A command arriving while a report is written is dropped */
+  if (report.field_fn != NULL)
+    return;
+
+  report.field_fn = field_fn;
+  report.lines = lines;
+  report.line = 0;
+  report.field = 0;
 }
 
-/*====================== Avenida Secundaria ===============================*/
-static void Avenida_Secundaria_Sinal_Verde(void *arg)
+/* Returns true in the middle of a line, the telemetry frames wait */
+static bool ReportFlush(void)
 {
-  chSysLockFromISR();
+  uint8_t buf[REPORT_FIELD_SIZE];
+  uint8_t len;
 
-  if (amb_sec == 0)
+  while (report.field_fn != NULL && SerialRoom() >= REPORT_FIELD_SIZE)
   {
-    counter++;
-
-    if (counter >= 6)
+    len = report.field_fn(report.line, report.field, buf);
+    if (len != 0)
     {
-      counter = 0;
-      STATE = SECUNDARIA;
-      LED_SECUNDARIA = AMARELO;
-      chVTReset((virtual_timer_t*)arg);
+      sdWrite(&SD1, buf, len);
+      report.field++;
+      continue;
     }
 
-    if (counter >= 5 && amb_pri == 1)
-    {
-      counter = 0;
-      palClearPad(IOPORT4, LED_VERDE_SECUNDARIA);
-      STATE = SECUNDARIA;
-      LED_SECUNDARIA = AMARELO;
-      chVTReset((virtual_timer_t*)arg);
-    }
+    /* End of line, the telemetry frames go between the lines */
+    sdWrite(&SD1, (const uint8_t *)"\r\n", 2);
+    report.field = 0;
+    if (++report.line == report.lines)
+      report.field_fn = NULL;
+    return false;
   }
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000), Avenida_Secundaria_Sinal_Verde, arg);
-  chSysUnlockFromISR();  
+  return report.field_fn != NULL && report.field != 0;
 }
 
-static void Avenida_Secundaria_Sinal_Amarelo(void *arg)
+/*
+  * Latency histograms, one line per intersection and request class:
+  *   L <intersection> <class> <max ms> <bucket 0> ... <bucket 16>
+  * classes are the REQ_* bit indexes, see latency.h for the buckets.
+*/
+static uint8_t LatencyField(uint8_t line, uint8_t field, uint8_t *buf)
 {
-  chSysLockFromISR();
-  
-  counter++;
+  const lat_hist_t *hp =
+    &intersections[line / LAT_CLASSES].lat.hist[line % LAT_CLASSES];
+  uint16_t n;
+
+  if (field == 0)
+    return FieldText(buf, "L ");
+  if (field == 1)
+    return FieldNum(buf, line / LAT_CLASSES);
+  if (field == 2)
+    return FieldNum(buf, line % LAT_CLASSES);
+  if (field > 3 + LAT_BUCKETS)
+    return 0;
+
+  /* The histograms are updated by the event threads */
+  chSysLock();
+  n = field == 3 ? hp->max_ms : hp->count[field - 4];
+  chSysUnlock();
+
+  return FieldNum(buf, n);
+}
+
+static void LatencyDump(void)
+{
+  ReportStart(LatencyField, INTERSECTIONS * LAT_CLASSES);
+}
 
-  if (counter >= 2)
+static void LatencyClear(void)
+{
+  for (uint8_t i = 0; i < INTERSECTIONS; i++)
   {
-    counter = 0;
-    palClearPad(IOPORT4, LED_VERDE_SECUNDARIA);
-    palClearPad(IOPORT4, LED_AMARELO_SECUNDARIA);
-    palSetPad(IOPORT4, LED_VERMELHO_SECUNDARIA);
+    chSysLock();
+    latClear(&intersections[i].lat);
+    chSysUnlock();
+  }
+}
 
-    if (amb_pri == 1)
-    {
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = VERDE;
-    }
+#if defined(IRQ_PROBE)
+/*
+  * Interrupt latency probe. TIMER2 overflows every 256 x 32 cycles and its
+  * handler reads how far the counter went on since the overflow: the time
+  * the interrupt waited for the interrupts to be enabled again, plus the
+  * constant handler entry. The max less the min is the longest interrupts
+  * disabled section taken anywhere, kernel and drivers included, seen by
+  * a sample every 512 us, and the mean less the min the average wait.
+  * 'i' prints
+  *   I <min cycles> <max cycles> <mean cycles> <samples> <missed>
+  * in multiples of 32 cycles, missed counts the samples that waited more
+  * than a period and are left out of the mean. 'r' clears it. The probe
+  * wakes the CPU up 1953 times per second, it is a diagnostic build.
+*/
+#define IRQ_PROBE_CYCLES 32 // TIMER2 prescaler
 
-    else if (((ped_sec >> 2) & ~0xFE) == 1)
-    {
-      ped_sec = 0;
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = VERDE;
-    }
-    
-    else if (EVENT == PEDESTRE)
-    {
-      ped_sec |= (1 << 1);
-      STATE = _PEDESTRE;
-      LED_PEDESTRE = VERDE;
-    }
+static struct
+{
+  uint8_t min, max;
+  uint32_t samples, missed;
+  uint64_t sum;                   // Counts of the samples not missed
+} irq_probe;
 
-    else
-    {
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = VERDE;
-    }
+CH_IRQ_HANDLER(TIMER2_OVF_vect)
+{
+  uint8_t count = TCNT2;
 
-    EVENT = 0;
-    chVTReset((virtual_timer_t*)arg);
+  CH_IRQ_PROLOGUE();
+
+  /* The overflow flag set again, the sample waited more than a period */
+  if (TIFR2 & (1 << TOV2))
+    irq_probe.missed++;
+  else
+  {
+    if (count < irq_probe.min)
+      irq_probe.min = count;
+    if (count > irq_probe.max)
+      irq_probe.max = count;
+    irq_probe.sum += count;
   }
+  irq_probe.samples++;
+
+  CH_IRQ_EPILOGUE();
+}
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000), Avenida_Secundaria_Sinal_Amarelo, arg);
-  chSysUnlockFromISR();
+static void IrqProbeClear(void)
+{
+  chSysLock();
+  irq_probe.min = UINT8_MAX;
+  irq_probe.max = 0;
+  irq_probe.samples = 0;
+  irq_probe.missed = 0;
+  irq_probe.sum = 0;
+  chSysUnlock();
 }
 
-/*====================== Via de Pedestre ===============================*/
-void Via_Pedestre_Sinal_Verde(void *arg)
+static void IrqProbeStart(void)
 {
-  chSysLockFromISR();
+  IrqProbeClear();
+  TCCR2A = 0;
+  TCNT2 = 0;
+  TIFR2 = (1 << TOV2);
+  TIMSK2 = (1 << TOIE2);
+  TCCR2B = (1 << CS21) | (1 << CS20);
+}
 
-  counter++;
+static uint8_t IrqProbeField(uint8_t line, uint8_t field, uint8_t *buf)
+{
+  uint32_t n, counted;
+  uint64_t sum;
+
+  (void)line;
+  if (field == 0)
+    return FieldText(buf, "I ");
+  if (field > 5)
+    return 0;
+
+  chSysLock();
+  counted = irq_probe.samples - irq_probe.missed;
+  sum = irq_probe.sum;
+  if (field == 1)
+    n = counted ? (uint32_t)irq_probe.min * IRQ_PROBE_CYCLES : 0;
+  else if (field == 2)
+    n = (uint32_t)irq_probe.max * IRQ_PROBE_CYCLES;
+  else if (field == 4)
+    n = irq_probe.samples;
+  else
+    n = irq_probe.missed;
+  chSysUnlock();
+
+  /* The 64 bits division runs after the lock */
+  if (field == 3)
+    n = counted ? (uint32_t)(sum * IRQ_PROBE_CYCLES / counted) : 0;
+
+  return FieldNum(buf, n);
+}
 
-  if (counter >= 3)
+static void IrqProbeDump(void)
+{
+  ReportStart(IrqProbeField, 1);
+}
+#endif
+
+#if defined(IDLE_REPORT)
+/*
+  * Idle time, accounted by the idle thread enter and leave hooks
+  * (chconf.h) on the system time stamps. 'p' prints
+  *   P <idle ms> <elapsed ms> <idle exits>
+  * since the boot or the last 'r': the share of the time the CPU spends in
+  * the idle thread, asleep but for the interrupts that wake no thread, and
+  * the thread wakeups out of it. It measures on the board what the README
+  * Power section derives, at the cost of a time stamp read on each switch
+  * to or from the idle thread.
+  *
+  * A time stamp loses a system time wrap (4.19 s) when the previous one is
+  * further back, and the CPU can stay in the idle thread much longer. The
+  * phase timers callback (engine.c) takes one at least every 4 s from its
+  * interrupt, inside the idle time, so the enter and leave stamps stay
+  * exact however long the idle stretch.
+*/
+static struct
+{
+  systimestamp_t since, entered, idle;
+  uint32_t exits;
+} idle_stats;
+
+/* Kernel hooks, called with the system locked, chVTGetTimeStampI is an
+   I-class read of the system time */
+void IdleEnterHook(void)
+{
+  idle_stats.entered = chVTGetTimeStampI();
+}
+
+void IdleLeaveHook(void)
+{
+  idle_stats.idle += chVTGetTimeStampI() - idle_stats.entered;
+  idle_stats.exits++;
+}
+
+static void IdleClear(void)
+{
+  chSysLock();
+  idle_stats.since = chVTGetTimeStampI();
+  idle_stats.idle = 0;
+  idle_stats.exits = 0;
+  chSysUnlock();
+}
+
+static uint32_t IdleMs(systimestamp_t ticks)
+{
+  return (uint32_t)(ticks * 1000 / CH_CFG_ST_FREQUENCY);
+}
+
+static uint8_t IdleField(uint8_t line, uint8_t field, uint8_t *buf)
+{
+  systimestamp_t idle, elapsed;
+  uint32_t exits;
+
+  (void)line;
+  if (field == 0)
+    return FieldText(buf, "P ");
+  if (field > 3)
+    return 0;
+
+  chSysLock();
+  idle = idle_stats.idle;
+  elapsed = chVTGetTimeStampI() - idle_stats.since;
+  exits = idle_stats.exits;
+  chSysUnlock();
+
+  if (field == 1)
+    return FieldNum(buf, IdleMs(idle));
+  if (field == 2)
+    return FieldNum(buf, IdleMs(elapsed));
+  return FieldNum(buf, exits);
+}
+
+static void IdleDump(void)
+{
+  ReportStart(IdleField, 1);
+}
+#endif
+
+#if defined(STACK_REPORT)
+/*
+  * Stacks peaks, one line per stack:
+  *   S <name> <working area size> <stack bytes> <peak bytes>
+  * tools/stacks.py turns the lines into stacks.h. The main stack has no
+  * working area, its stack bytes are the free RAM above the .bss. The idle
+  * working area size is PORT_IDLE_THREAD_STACK_SIZE, chconf.h takes it
+  * from stacks.h, its bounds are only known at run time and StackField()
+  * fills them in.
+*/
+/* The thread_t lives at the top of the working area, the stack below it */
+#define WA_STACK(wa) (sizeof(wa) - sizeof(thread_t))
+#define IDLE_STACK   (IDLE_WA_SIZE - sizeof(thread_t))
+
+typedef struct
+{
+  const char *name;
+  uint16_t wa_size;
+  const uint8_t *base;
+  uint16_t stack;
+} stack_line_t;
+
+/* The main stack is the line after these */
+static const stack_line_t stack_lines[] =
+{
+#if !defined(EVENT_LOOP)
+  {"read_event", WA_READ_EVENT_SIZE, (const uint8_t *)wa_ReadEvent,
+   WA_STACK(wa_ReadEvent)},
+  {"process_event", WA_PROCESS_EVENT_SIZE, (const uint8_t *)wa_ProcessEvent,
+   WA_STACK(wa_ProcessEvent)},
+#endif
+  {"idle", PORT_IDLE_THREAD_STACK_SIZE, NULL, 0},
+};
+
+#define STACK_LINES (sizeof(stack_lines) / sizeof(stack_lines[0]))
+
+static uint8_t StackField(uint8_t line, uint8_t field, uint8_t *buf)
+{
+  const stack_line_t *sp = line < STACK_LINES ? &stack_lines[line] : NULL;
+  stack_line_t idle;
+
+  /* The idle line has no base in the table */
+  if (sp && !sp->base)
   {
-    counter = 0;
-    STATE = _PEDESTRE;
-    LED_PEDESTRE = AMARELO;
-    chVTReset((virtual_timer_t*)arg);
+    idle = *sp;
+    idle.base = IDLE_WA_BASE;
+    idle.stack = IDLE_STACK;
+    sp = &idle;
   }
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000), Via_Pedestre_Sinal_Verde, arg);
-  chSysUnlockFromISR();
+  switch (field)
+  {
+    case 0:
+      return FieldText(buf, "S ");
+    case 1:
+      return FieldText(buf, sp ? sp->name : "main");
+    case 2:
+      return FieldText(buf, " ");
+    case 3:
+      return FieldNum(buf, sp ? sp->wa_size : 0);
+    case 4:
+      return FieldNum(buf, sp ? sp->stack : stkMainSize());
+    case 5:
+      return FieldNum(buf, sp ? sp->stack - stkUnused(sp->base, sp->stack) :
+                                stkMainPeak());
+    default:
+      return 0;
+  }
+}
+
+static void StackReport(void)
+{
+  ReportStart(StackField, STACK_LINES + 1);
+}
+#endif
+
+#if defined(CYCLE_BENCH)
+/*
+  * Hot paths cycle cost, measured once at startup before the threads and
+  * the phase timers start, one line per path:
+  *   C <name> <min> <avg> <max> <overflows>
+  * TIMER2 counts at F_CPU / 8, the figures are multiples of 8 cycles with
+  * the measurement overhead removed; the interrupts taken during a run
+  * (system timer alarms, USART) show up in avg and max, min is the path
+  * alone. The 8 bits counter covers 2040 cycles, the longer runs are only
+  * counted in overflows and left out of the figures. phase_tick
+  * runs with the interrupts disabled from end to end, phase_run is the
+  * collector side of the expiry.
+*/
+#define BENCH_RUNS 64
+
+/* The bench runs before the threads, its lines may wait on the port */
+static void SerialNum(uint32_t n)
+{
+  uint8_t buf[REPORT_FIELD_SIZE];
+
+  sdWrite(&SD1, buf, FieldNum(buf, n));
 }
 
-void Via_Pedestre_Sinal_Amarelo(void *arg)
+typedef struct
 {
-  chSysLockFromISR();
+  uint16_t min, max;
+  uint32_t total;
+  uint8_t runs, overflows;
+} bench_t;
+
+#define BENCH_INIT {UINT16_MAX, 0, 0, 0, 0}
 
-  palTogglePad(IOPORT3, LED_VERMELHO_PEDESTRE);
-  counter++;
+static uint16_t bench_overhead;
 
-  if (counter >= 4)
+static void BenchBegin(void)
+{
+  TIFR2 = (1 << TOV2);
+  TCNT2 = 0;
+}
+
+static uint16_t BenchEnd(void)
+{
+  uint8_t count = TCNT2;
+
+  if (TIFR2 & (1 << TOV2))
+    return UINT16_MAX;
+  return (uint16_t)count * 8;
+}
+
+static void BenchAdd(bench_t *bp, uint16_t cycles)
+{
+  if (cycles == UINT16_MAX)
   {
-    counter = 0;
+    bp->overflows++;
+    return;
+  }
 
-    if (((ped_sec >> 1) & ~0xFE) == 1)
-    {
-      ped_sec = 0;
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = VERDE;
-    }
+  cycles = cycles > bench_overhead ? cycles - bench_overhead : 0;
+  if (cycles < bp->min)
+    bp->min = cycles;
+  if (cycles > bp->max)
+    bp->max = cycles;
+  bp->total += cycles;
+  bp->runs++;
+}
 
-    else if (((ped_sec >> 2) & ~0xFE) == 1)
-    {
-      if (EVENT == CARRO_SECUNDARIA || flag == 1)
-      {
-        flag = 0;
-        STATE = SECUNDARIA;
-        LED_SECUNDARIA = VERDE;
-      }
-
-      else 
-      {
-        STATE = PRINCIPAL;
-        LED_PRINCIPAL = VERDE;  
-      }    
-    }
+static void BenchLine(const char *name, const bench_t *bp)
+{
+  sdWrite(&SD1, (const uint8_t *)"C ", 2);
+  sdWrite(&SD1, (const uint8_t *)name, strlen(name));
+  sdPut(&SD1, ' ');
+  SerialNum(bp->runs ? bp->min : 0);
+  SerialNum(bp->runs ? bp->total / bp->runs : 0);
+  SerialNum(bp->max);
+  SerialNum(bp->overflows);
+  sdWrite(&SD1, (const uint8_t *)"\r\n", 2);
+}
 
-    else
-    {
-      STATE = PRINCIPAL;
-      LED_PRINCIPAL = VERDE;     
-    }
+static void CycleBench(void)
+{
+  intersection_t *isp = &intersections[0];
+  bench_t push = BENCH_INIT, pop = BENCH_INIT, tick = BENCH_INIT;
+  bench_t run = BENCH_INIT, lamps = BENCH_INIT;
+  uint16_t cycles;
+  uint8_t msg;
+
+  TCCR2A = 0;
+  TCCR2B = (1 << CS21);
 
-    palSetPad(IOPORT3, LED_VERMELHO_PEDESTRE);
+  bench_overhead = UINT16_MAX;
+  for (uint8_t i = 0; i < BENCH_RUNS; i++)
+  {
+    BenchBegin();
+    cycles = BenchEnd();
+    if (cycles < bench_overhead)
+      bench_overhead = cycles;
+  }
 
-    EVENT = 0;
-    chVTReset((virtual_timer_t*)arg);
+  /* The timer callback and the lamps events are posted to this thread
+     until the real threads exist.*/
+  process_tp = main_tp;
+  for (uint8_t i = 0; i < BENCH_RUNS; i++)
+  {
+    BenchBegin();
+    PushBUffer(EVQ_MSG(0, PEDESTRE));
+    BenchAdd(&push, BenchEnd());
+
+    BenchBegin();
+    msg = PopBUffer();
+    BenchAdd(&pop, BenchEnd());
+
+    /* A pedestrian request pending keeps the controller going through its
+       phases instead of holding the main avenue green */
+    CollectEvent(msg);
+
+    BenchBegin();
+    engPhaseTick(&isp->vt, isp);
+    BenchAdd(&tick, BenchEnd());
+
+    /* Collected at its deadline, the controller takes the decision due:
+       a phase change, a blink toggle or an intermediate wakeup */
+    msg = PopBUffer();
+    isp->armed_at -= TIME_MS2I(isp->wait);
+    BenchBegin();
+    CollectEvent(msg);
+    BenchAdd(&run, BenchEnd());
+
+    BenchBegin();
+    ProcessLamps(EVT_LAMPS(0));
+    BenchAdd(&lamps, BenchEnd());
   }
+  TCCR2B = 0;
 
-  chVTSetI((virtual_timer_t*)arg, TIME_MS2I(1000 / 2), Via_Pedestre_Sinal_Amarelo, arg);
-  chSysUnlockFromISR();
+  /* Back to the startup state */
+  chVTReset(&isp->vt);
+  isp->wait = 0;
+  ctlInit(&isp->ctl);
+  latInit(&isp->lat, CH_CFG_ST_FREQUENCY);
+  InitBuffer();
+  tlmInit();
+  (void)chEvtGetAndClearEvents(ALL_EVENTS);
+  process_tp = NULL;
+
+  BenchLine("push", &push);
+  BenchLine("pop", &pop);
+  BenchLine("phase_tick", &tick);
+  BenchLine("phase_run", &run);
+  BenchLine("lamps", &lamps);
 }
+#endif
@@ -0,0 +1,393 @@
+/*
+  * Dual ring, barrier phase controller (NEMA TS2 style).
+  *
+  * Up to 8 vehicle phases in two rings, each with an optional pedestrian
+  * movement, yellow and all red clearance intervals. Like controller.c it
+  * has no dependency on ChibiOS: the caller places the calls, provides the
+  * time with nemaTick() and arms a one-shot timer on nemaWaitMs().
+  *
+  * A ring serves the called phases of the current barrier group in sequence
+  * order. A green rests while nothing conflicting is called, otherwise it
+  * ends after its minimum, extended by the passage of each call on its own
+  * phase up to the maximum, timed from the first conflicting call. The
+  * barrier is crossed when both rings are idle and a call waits for a phase
+  * they can no longer reach in this group.
+*/
+
+#include "nema.h"
+#include "rom.h"
+
+/* Ring intervals */
+#define INT_IDLE      0
+#define INT_GREEN     1
+#define INT_YELLOW    2
+#define INT_RED_CLEAR 3
+
+#define PHASE_BIT(phase) (1 << (phase))
+#define SAT_ADD(a, b)    ((a) > UINT32_MAX - (b) ? UINT32_MAX : (a) + (b))
+
+static const nema_phase_t *nemaPhase(const nema_t *n, uint8_t phase)
+{
+  return &n->cfg->phase[phase];
+}
+
+static uint8_t nemaSeq(const nema_t *n, uint8_t r, uint8_t pos)
+{
+  return rom_byte(&n->cfg->seq[r][pos]);
+}
+
+static uint8_t nemaGroup(const nema_t *n, uint8_t phase)
+{
+  return rom_byte(&nemaPhase(n, phase)->group);
+}
+
+static uint8_t nemaPending(const nema_t *n)
+{
+  return n->calls | n->recall | n->ped_calls;
+}
+
+/* Phases of the current group after the served position of a ring */
+static uint8_t nemaLater(const nema_t *n, uint8_t r)
+{
+  const nema_ring_t *rp = &n->ring[r];
+  uint8_t mask = 0;
+
+  for (uint8_t pos = rp->pos == NEMA_NONE ? 0 : rp->pos + 1; pos < NEMA_SEQ; pos++)
+  {
+    uint8_t phase = nemaSeq(n, r, pos);
+
+    if (phase != NEMA_NONE && nemaGroup(n, phase) == n->group)
+      mask |= PHASE_BIT(phase);
+  }
+  return mask;
+}
+
+static uint8_t nemaCurrent(const nema_t *n, uint8_t r)
+{
+  return nemaSeq(n, r, n->ring[r].pos);
+}
+
+/*
+  * A call the rings can no longer serve in this group: the barrier has to
+  * be crossed, and crossed back for a call in this group.
+*/
+static uint8_t nemaCrossing(const nema_t *n)
+{
+  uint8_t reach = 0, vehicles = n->calls | n->recall;
+
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    reach |= nemaLater(n, r);
+    if (n->ring[r].interval == INT_GREEN)
+      vehicles &= ~PHASE_BIT(nemaCurrent(n, r));
+  }
+  return ((vehicles | n->ped_calls) & ~reach) != 0;
+}
+
+/* A call waits for a phase the green of this ring has to end for */
+static uint8_t nemaDemand(const nema_t *n, uint8_t r)
+{
+  return (nemaPending(n) & nemaLater(n, r)) != 0 || nemaCrossing(n);
+}
+
+static uint16_t nemaMinGreen(const nema_t *n, uint8_t r)
+{
+  const nema_phase_t *p = nemaPhase(n, nemaCurrent(n, r));
+  uint16_t min = rom_word(&p->min_green_ms);
+  uint16_t walk = rom_word(&p->walk_ms) + rom_word(&p->ped_clear_ms);
+
+  return (n->ring[r].walk && walk > min) ? walk : min;
+}
+
+/*
+  * Milliseconds left before the green can end once a conflicting call
+  * waits: the minimum, the passage extensions and the maximum, timed from
+  * the first conflicting call as the green elapsed since it and not as an
+  * end time, which a long rest would saturate.
+*/
+static uint32_t nemaGreenLeft(const nema_t *n, uint8_t r)
+{
+  const nema_ring_t *rp = &n->ring[r];
+  uint32_t min = nemaMinGreen(n, r);
+  uint32_t max = rom_word(&nemaPhase(n, nemaCurrent(n, r))->max_green_ms);
+  uint32_t since = rp->demand ? rp->elapsed - rp->demand_at : 0;
+  uint32_t left = rp->extend > rp->elapsed ? rp->extend - rp->elapsed : 0;
+
+  if (left > max - (since < max ? since : max))
+    left = max - (since < max ? since : max);
+  if (rp->elapsed < min && left < min - rp->elapsed)
+    left = min - rp->elapsed;
+  return left;
+}
+
+static void nemaEnter(nema_t *n, uint8_t r, uint8_t interval)
+{
+  n->ring[r].interval = interval;
+  n->ring[r].elapsed = 0;
+}
+
+static void nemaStartGreen(nema_t *n, uint8_t r, uint8_t pos)
+{
+  nema_ring_t *rp = &n->ring[r];
+  uint8_t phase = nemaSeq(n, r, pos);
+
+  rp->pos = pos;
+  rp->extend = 0;
+  rp->demand = 0;
+  rp->walk = (n->ped_calls & PHASE_BIT(phase)) != 0;
+  n->calls &= ~PHASE_BIT(phase);
+  n->ped_calls &= ~PHASE_BIT(phase);
+  nemaEnter(n, r, INT_GREEN);
+}
+
+/* Starts the next called phase of the group in sequence, if any */
+static uint8_t nemaNext(nema_t *n, uint8_t r)
+{
+  uint8_t later = nemaLater(n, r) & nemaPending(n);
+
+  if (later == 0)
+    return 0;
+
+  for (uint8_t pos = n->ring[r].pos == NEMA_NONE ? 0 : n->ring[r].pos + 1; pos < NEMA_SEQ; pos++)
+  {
+    uint8_t phase = nemaSeq(n, r, pos);
+
+    if (phase != NEMA_NONE && (later & PHASE_BIT(phase)))
+    {
+      nemaStartGreen(n, r, pos);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* One pass of the interval rules of a ring, returns whether it moved */
+static uint8_t nemaRing(nema_t *n, uint8_t r)
+{
+  nema_ring_t *rp = &n->ring[r];
+  const nema_phase_t *p;
+
+  if (rp->interval == INT_IDLE)
+    return nemaNext(n, r);
+
+  p = nemaPhase(n, nemaCurrent(n, r));
+  switch (rp->interval)
+  {
+    case INT_GREEN:
+      /* Calls during the green extend it, a pedestrian arriving during the
+         walk is served by it.*/
+      if (n->calls & PHASE_BIT(nemaCurrent(n, r)))
+      {
+        n->calls &= ~PHASE_BIT(nemaCurrent(n, r));
+        rp->extend = SAT_ADD(rp->elapsed, rom_word(&p->passage_ms));
+      }
+      if (rp->walk && rp->elapsed < rom_word(&p->walk_ms))
+        n->ped_calls &= ~PHASE_BIT(nemaCurrent(n, r));
+
+      /* The max green starts with the first conflicting call */
+      if (!nemaDemand(n, r))
+        return 0;
+      if (!rp->demand)
+      {
+        rp->demand = 1;
+        rp->demand_at = rp->elapsed;
+      }
+
+      if (nemaGreenLeft(n, r) != 0)
+        return 0;
+      nemaEnter(n, r, INT_YELLOW);
+      return 1;
+
+    case INT_YELLOW:
+      if (rp->elapsed < rom_word(&p->yellow_ms))
+        return 0;
+      nemaEnter(n, r, INT_RED_CLEAR);
+      return 1;
+
+    default:
+      if (rp->elapsed < rom_word(&p->red_clear_ms))
+        return 0;
+      if (!nemaNext(n, r))
+        nemaEnter(n, r, INT_IDLE);
+      return 1;
+  }
+}
+
+/* Both rings idle at the barrier, crosses it when a call waits */
+static uint8_t nemaBarrier(nema_t *n)
+{
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    if (n->ring[r].interval != INT_IDLE)
+      return 0;
+  }
+  if (!nemaCrossing(n))
+    return 0;
+
+  n->group ^= 1;
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    n->ring[r].pos = NEMA_NONE;
+    nemaNext(n, r);
+  }
+  return 1;
+}
+
+static void nemaRun(nema_t *n)
+{
+  /* Every pass moves a ring by one interval, the bound only guards a
+     configuration with no phase at all in the called group.*/
+  for (uint8_t pass = 0; pass < 4 * NEMA_RINGS + 2; pass++)
+  {
+    uint8_t moved = 0;
+
+    for (uint8_t r = 0; r < NEMA_RINGS; r++)
+      moved |= nemaRing(n, r);
+    moved |= nemaBarrier(n);
+    if (!moved)
+      return;
+  }
+}
+
+void nemaInit(nema_t *n, const nema_cfg_t *cfg)
+{
+  n->cfg = cfg;
+  n->group = 0;
+  n->calls = 0;
+  n->ped_calls = 0;
+  n->recall = 0;
+  for (uint8_t phase = 0; phase < NEMA_PHASES; phase++)
+  {
+    if (rom_byte(&nemaPhase(n, phase)->flags) & NEMA_RECALL)
+      n->recall |= PHASE_BIT(phase);
+  }
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    n->ring[r].pos = NEMA_NONE;
+    n->ring[r].walk = 0;
+    n->ring[r].demand = 0;
+    nemaEnter(n, r, INT_IDLE);
+  }
+  nemaRun(n);
+}
+
+/* Vehicle detector call, extends the green of its phase */
+void nemaCall(nema_t *n, uint8_t phase)
+{
+  if (phase < NEMA_PHASES)
+    n->calls |= PHASE_BIT(phase);
+}
+
+void nemaPedCall(nema_t *n, uint8_t phase)
+{
+  if (phase < NEMA_PHASES && (rom_byte(&nemaPhase(n, phase)->flags) & NEMA_PED))
+    n->ped_calls |= PHASE_BIT(phase);
+}
+
+/*
+  * Advances the rings by the ms elapsed since the previous call and takes
+  * the decisions due by now, the caller also runs it after placing calls.
+*/
+uint8_t nemaTick(nema_t *n, uint16_t ms)
+{
+  uint32_t before = nemaImage(n);
+
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    if (n->ring[r].interval != INT_IDLE)
+      n->ring[r].elapsed = SAT_ADD(n->ring[r].elapsed, ms);
+  }
+  nemaRun(n);
+
+  return nemaImage(n) != before ? NEMA_SIGNALS_CHANGED : 0;
+}
+
+/*
+  * Milliseconds from the last nemaTick() to the next decision point of any
+  * ring, NEMA_WAIT_NONE when every green rests until a new call.
+*/
+uint16_t nemaWaitMs(const nema_t *n)
+{
+  uint32_t wait = UINT32_MAX;
+
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    const nema_ring_t *rp = &n->ring[r];
+    const nema_phase_t *p;
+    uint32_t limit, left = UINT32_MAX;
+
+    if (rp->interval == INT_IDLE)
+      continue;
+
+    p = nemaPhase(n, nemaCurrent(n, r));
+    if (rp->interval == INT_GREEN)
+    {
+      uint32_t walk = rom_word(&p->walk_ms);
+      uint32_t clear = walk + rom_word(&p->ped_clear_ms);
+
+      if (nemaDemand(n, r))
+        left = nemaGreenLeft(n, r);
+      if (rp->walk && rp->elapsed < walk && walk - rp->elapsed < left)
+        left = walk - rp->elapsed;
+      else if (rp->walk && rp->elapsed < clear && clear - rp->elapsed < left)
+        left = clear - rp->elapsed;
+    }
+    else
+    {
+      limit = rom_word(rp->interval == INT_YELLOW ? &p->yellow_ms : &p->red_clear_ms);
+      left = limit > rp->elapsed ? limit - rp->elapsed : 0;
+    }
+
+    if (left < wait)
+      wait = left;
+  }
+
+  if (wait == UINT32_MAX)
+    return NEMA_WAIT_NONE;
+  return wait < NEMA_WAIT_NONE ? (uint16_t)wait : NEMA_WAIT_NONE - 1;
+}
+
+uint8_t nemaSignal(const nema_t *n, uint8_t phase)
+{
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    const nema_ring_t *rp = &n->ring[r];
+
+    if (rp->interval == INT_IDLE || rp->interval == INT_RED_CLEAR ||
+        nemaCurrent(n, r) != phase)
+      continue;
+    return rp->interval == INT_GREEN ? NEMA_GREEN : NEMA_YELLOW;
+  }
+  return NEMA_RED;
+}
+
+uint8_t nemaPedSignal(const nema_t *n, uint8_t phase)
+{
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    const nema_ring_t *rp = &n->ring[r];
+    const nema_phase_t *p;
+
+    if (rp->interval != INT_GREEN || !rp->walk || nemaCurrent(n, r) != phase)
+      continue;
+    p = nemaPhase(n, phase);
+    if (rp->elapsed < rom_word(&p->walk_ms))
+      return NEMA_WALK;
+    if (rp->elapsed < rom_word(&p->walk_ms) + rom_word(&p->ped_clear_ms))
+      return NEMA_PED_CLEAR;
+  }
+  return NEMA_DONT_WALK;
+}
+
+/* Every signal, two bits per vehicle phase then two per pedestrian one */
+uint32_t nemaImage(const nema_t *n)
+{
+  uint32_t image = 0;
+
+  for (uint8_t phase = 0; phase < NEMA_PHASES; phase++)
+  {
+    image |= (uint32_t)nemaSignal(n, phase) << (2 * phase);
+    image |= (uint32_t)nemaPedSignal(n, phase) << (2 * (NEMA_PHASES + phase));
+  }
+  return image;
+}
@@ -0,0 +1,89 @@
+#ifndef NEMA_H
+#define NEMA_H
+
+#include <stdint.h>
+
+/*
+  * Controller sizes, fixed at compile time so its RAM never changes
+*/
+#define NEMA_PHASES 8    // Vehicle phases, NEMA phases 1..8 are indexes 0..7
+#define NEMA_RINGS  2
+#define NEMA_SEQ    8    // Positions of a ring sequence
+#define NEMA_NONE   0xFF // Unused sequence position
+
+/* Phase flags */
+#define NEMA_RECALL (1 << 0) // Served on every cycle without a call
+#define NEMA_PED    (1 << 1) // Has a pedestrian movement
+
+/* Vehicle signals, nemaSignal() */
+#define NEMA_RED       0
+#define NEMA_GREEN     1
+#define NEMA_YELLOW    2
+
+/* Pedestrian signals, nemaPedSignal() */
+#define NEMA_DONT_WALK 0
+#define NEMA_WALK      1
+#define NEMA_PED_CLEAR 2 // Flashing don't walk
+
+/* nemaTick() results */
+#define NEMA_SIGNALS_CHANGED (1 << 0)
+
+/* nemaWaitMs() result when no decision is due until a new call */
+#define NEMA_WAIT_NONE UINT16_MAX
+
+typedef struct
+{
+  uint16_t min_green_ms;
+  uint16_t max_green_ms;  // Green limit after the first conflicting call
+  uint16_t passage_ms;    // Green extension of each call during the green
+  uint16_t yellow_ms;
+  uint16_t red_clear_ms;  // All red after the yellow
+  uint16_t walk_ms;
+  uint16_t ped_clear_ms;
+  uint8_t  group;         // Barrier group, 0 or 1
+  uint8_t  flags;         // NEMA_RECALL, NEMA_PED
+} nema_phase_t;
+
+/*
+  * Ring and barrier layout. Each ring runs its sequence one phase at a time,
+  * the phases of group 0 first. Phases of the same group in different rings
+  * never conflict and run together, both rings cross the barrier between
+  * the groups at the same time.
+*/
+typedef struct
+{
+  nema_phase_t phase[NEMA_PHASES];
+  uint8_t seq[NEMA_RINGS][NEMA_SEQ]; // Phase indexes, NEMA_NONE pads
+} nema_cfg_t;
+
+typedef struct
+{
+  uint8_t  pos;           // Sequence position served, NEMA_NONE before the first
+  uint8_t  interval;      // Green, yellow, red clearance or idle at the barrier
+  uint8_t  walk;          // The green started with a pedestrian walk
+  uint8_t  demand;        // A conflicting call waits for the green to end
+  uint32_t elapsed;       // Milliseconds in the interval, saturated
+  uint32_t extend;        // Green end required by the calls during the green
+  uint32_t demand_at;     // Green elapsed at the first conflicting call
+} nema_ring_t;
+
+typedef struct
+{
+  const nema_cfg_t *cfg;  // In flash on AVR
+  nema_ring_t ring[NEMA_RINGS];
+  uint8_t group;          // Barrier group being served
+  uint8_t recall;         // Phases with NEMA_RECALL
+  uint8_t calls;          // Vehicle calls, one bit per phase
+  uint8_t ped_calls;      // Pedestrian calls, one bit per phase
+} nema_t;
+
+void nemaInit(nema_t *n, const nema_cfg_t *cfg);
+void nemaCall(nema_t *n, uint8_t phase);
+void nemaPedCall(nema_t *n, uint8_t phase);
+uint8_t nemaTick(nema_t *n, uint16_t ms);
+uint16_t nemaWaitMs(const nema_t *n);
+uint8_t nemaSignal(const nema_t *n, uint8_t phase);
+uint8_t nemaPedSignal(const nema_t *n, uint8_t phase);
+uint32_t nemaImage(const nema_t *n);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <stdint.h>
+
+/*
+  * Constant tables kept in flash. On AVR they need PROGMEM and the LPM
+  * accessors, otherwise they would be copied to RAM at startup.
+*/
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define ROM              PROGMEM
+#define rom_byte(p)      pgm_read_byte(p)
+#define rom_word(p)      pgm_read_word(p)
+#else
+#define ROM
+#define rom_byte(p)      (*(const uint8_t *)(p))
+#define rom_word(p)      (*(const uint16_t *)(p))
+#endif
+
+#endif
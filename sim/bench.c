@@ -0,0 +1,210 @@
+/*
+  * Discrete-event benchmark of the controller.
+  *
+  * Drives the firmware engine (engine.c, see sim_engine.h: press
+  * coalescing, event queue, collector, phase timer, lamps) through the
+  * virtual clock scheduler with synthetic Poisson arrivals and
+  * reports the simulation throughput. Heap allocations are counted through
+  * the linker --wrap of the allocator functions. The lamps writers, the
+  * constant wiring one and lampsWrite() through its map, are then timed on
+  * their own.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "sim_clock.h"
+#include "sim_engine.h"
+#include "controller.h"
+#include "lamps.h"
+#include "evqueue.h"
+
+#define AMBULANCE_PASS_MS 30000
+#define WRITER_RUNS       2000000
+#define WRITER_ROUNDS     5
+
+typedef struct
+{
+  uint8_t event;
+  double per_hour;
+  sim_timer_t timer;
+} arrival_t;
+
+static uint64_t transitions, arrivals, dropped;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+static uint64_t allocations;
+static int counting;
+
+/* The firmware single intersection writer, on the simulated PAL */
+LAMPS_WRITER(benchLampsWrite, lamps_board_lut, LAMPS_BOARD_PORTS)
+
+static arrival_t sources[] =
+{
+  {PEDESTRE,              120, {0}},
+  {CARRO_SECUNDARIA,      240, {0}},
+  {AMBULANCIA_PRINCIPAL,  2,   {0}},
+  {AMBULANCIA_SECUNDARIA, 2,   {0}},
+};
+
+#define SOURCES_NUM (sizeof(sources) / sizeof(sources[0]))
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+  allocations += counting;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  allocations += counting;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+  allocations += counting;
+  return __real_realloc(p, size);
+}
+
+static double rngUniform(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static uint32_t rngExpMs(double per_hour)
+{
+  return (uint32_t)(-log(rngUniform()) * 3600000.0 / per_hour) + 1;
+}
+
+/* The firmware Process Event writes the lamps */
+static void changed(intersection_t *isp, uint8_t changes)
+{
+  if (changes & CTL_PHASE_CHANGED)
+    transitions++;
+  if (changes & CTL_LAMPS_CHANGED)
+    benchLampsWrite(isp->ctl.lamps);
+}
+
+/* The firmware buttons interrupt, the collector runs on the next dispatch */
+static void buttonPress(uint8_t event)
+{
+  uint64_t drops = sim_dropped;
+
+  arrivals++;
+  engPressI(&sim_units[0], event, chVTGetTimeStampI());
+  dropped += sim_dropped - drops;
+}
+
+static void arrival(void *arg);
+
+static void ambulancePassed(void *arg)
+{
+  arrival_t *ap = arg;
+
+  buttonPress(ap->event);
+  simTimerSet(&ap->timer, rngExpMs(ap->per_hour), arrival, ap);
+}
+
+static void arrival(void *arg)
+{
+  arrival_t *ap = arg;
+
+  buttonPress(ap->event);
+  if (ap->event == AMBULANCIA_PRINCIPAL || ap->event == AMBULANCIA_SECUNDARIA)
+    simTimerSet(&ap->timer, AMBULANCE_PASS_MS, ambulancePassed, ap);
+  else
+    simTimerSet(&ap->timer, rngExpMs(ap->per_hour), arrival, ap);
+}
+
+static double wallSeconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Wall ns per write of the lamps writer over every lamps byte, the best
+   of a few rounds */
+static double writerNs(int constant)
+{
+  double best = 0;
+
+  for (int r = 0; r < WRITER_ROUNDS; r++)
+  {
+    double t0 = wallSeconds(), ns;
+
+    for (uint32_t i = 0; i < WRITER_RUNS; i++)
+    {
+      if (constant)
+        benchLampsWrite((uint8_t)i);
+      else
+        lampsWrite(&lamps_board, (uint8_t)i);
+    }
+
+    ns = (wallSeconds() - t0) * 1e9 / WRITER_RUNS;
+    if (r == 0 || ns < best)
+      best = ns;
+  }
+
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  double hours = 10000, load = 1, t0, wall;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:l:")) != -1)
+  {
+    switch (opt)
+    {
+      case 't': hours = atof(optarg); break;
+      case 'l': load = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-t simulated hours] [-l arrival rate multiplier]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  simClockInit(0);
+  simPalInit();
+  simEngineInit(1, changed);
+  benchLampsWrite(sim_units[0].ctl.lamps);
+  for (size_t i = 0; i < SOURCES_NUM; i++)
+  {
+    sources[i].per_hour *= load;
+    simTimerSet(&sources[i].timer, rngExpMs(sources[i].per_hour), arrival, &sources[i]);
+  }
+
+  counting = 1;
+  t0 = wallSeconds();
+  simRunUntil((uint64_t)(hours * 3600000.0));
+  wall = wallSeconds() - t0;
+  counting = 0;
+
+  printf("simulated time        %.0f s\n", hours * 3600.0);
+  printf("wall time             %.3f s\n", wall);
+  printf("sim s per wall s      %.3g\n", hours * 3600.0 / wall);
+  printf("events dispatched     %llu (%.3g/s)\n", (unsigned long long)simDispatched(), simDispatched() / wall);
+  printf("phase timer callbacks %llu (%.3g/s)\n", (unsigned long long)sim_expiries,
+         sim_expiries / wall);
+  printf("phase transitions     %llu (%.3g/s)\n", (unsigned long long)transitions, transitions / wall);
+  printf("button arrivals       %llu, %llu dropped\n", (unsigned long long)arrivals, (unsigned long long)dropped);
+  printf("port writes           %u\n", sim_pal_writes);
+  printf("heap allocations      %llu\n", (unsigned long long)allocations);
+  printf("lamps write, constant %.2f ns\n", writerNs(1));
+  printf("lamps write, map      %.2f ns\n", writerNs(0));
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+  * ChibiOS RT subset of the host build, the kernel calls of engine.c on the
+  * virtual clock. The system time counts CH_CFG_ST_FREQUENCY ticks in 16
+  * bits and the conversions round up like the kernel ones, so the phase
+  * timers run the firmware arithmetic, wrap and caps included. The time
+  * stamps are the RT7 ones, extended from the system time at each call and
+  * short of the wraps between two calls more than a wrap apart. A virtual
+  * timer is a simulation clock timer, armed on the millisecond its ticks
+  * reach. There is one thread, locking is empty.
+*/
+
+#ifndef SIM_CH_H
+#define SIM_CH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_clock.h"
+
+#define CH_CFG_ST_FREQUENCY 15624
+
+typedef uint16_t systime_t;
+typedef uint16_t sysinterval_t;
+typedef uint64_t systimestamp_t;
+typedef uint64_t time_conv_t;
+
+typedef struct virtual_timer virtual_timer_t;
+typedef void (*vtfunc_t)(virtual_timer_t *vtp, void *p);
+
+struct virtual_timer
+{
+  sim_timer_t timer;
+  vtfunc_t func;
+  void *par;
+};
+
+#define TIME_MS2I(msecs)                                                  \
+  ((sysinterval_t)((((time_conv_t)(msecs) * CH_CFG_ST_FREQUENCY) + 999) / \
+                   1000))
+#define TIME_I2MS(interval)                                               \
+  ((uint32_t)((((time_conv_t)(interval) * 1000) +                         \
+               CH_CFG_ST_FREQUENCY - 1) / CH_CFG_ST_FREQUENCY))
+
+#define chSysLock()
+#define chSysUnlock()
+#define chSysLockFromISR()
+#define chSysUnlockFromISR()
+#define chSchRescheduleS()
+
+/* Last time stamp and virtual timer callbacks run, sim_engine.c */
+extern systimestamp_t sim_laststamp;
+extern uint64_t sim_expiries;
+
+/* Ticks of the virtual clock, the system time is their low 16 bits */
+static inline uint64_t simTicks(void)
+{
+  return simNow() * CH_CFG_ST_FREQUENCY / 1000;
+}
+
+static inline systime_t chVTGetSystemTimeX(void)
+{
+  return (systime_t)simTicks();
+}
+
+static inline sysinterval_t chTimeDiffX(systime_t start, systime_t end)
+{
+  return (sysinterval_t)(end - start);
+}
+
+/* The last stamp plus the system time elapsed since, as RT7 does */
+static inline systimestamp_t chVTGetTimeStampI(void)
+{
+  sim_laststamp += chTimeDiffX((systime_t)sim_laststamp, chVTGetSystemTimeX());
+  return sim_laststamp;
+}
+
+static inline void chVTObjectInit(virtual_timer_t *vtp)
+{
+  vtp->timer.armed = false;
+}
+
+static inline bool chVTIsArmedI(const virtual_timer_t *vtp)
+{
+  return vtp->timer.armed;
+}
+
+static inline void chVTResetI(virtual_timer_t *vtp)
+{
+  simTimerReset(&vtp->timer);
+}
+
+static inline void simVTFire(void *arg)
+{
+  virtual_timer_t *vtp = arg;
+
+  sim_expiries++;
+  vtp->func(vtp, vtp->par);
+}
+
+/* Expires on the first millisecond the system time is delay ticks later */
+static inline void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay,
+                            vtfunc_t vtfunc, void *par)
+{
+  uint64_t due = simTicks() + delay;
+  uint64_t ms = (due * 1000 + CH_CFG_ST_FREQUENCY - 1) / CH_CFG_ST_FREQUENCY;
+
+  vtp->func = vtfunc;
+  vtp->par = par;
+  simTimerSet(&vtp->timer, (uint32_t)(ms - simNow()), simVTFire, vtp);
+}
+
+#endif
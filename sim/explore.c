@@ -0,0 +1,414 @@
+/*
+  * Exhaustive state space explorer of the phase controller.
+  *
+  * Enumerates every controller state reachable from ctlInit() under all the
+  * interleavings of button presses and elapsed time, running the actual
+  * controller.c code, and checks:
+  *
+  *   - no state opens two conflicting signal heads, no head is green and
+  *     red at once, no vehicle green goes to red without its yellow;
+  *   - every pedestrian and car request is served, with the worst case wait
+  *     under any further presses, while no ambulance holds a preemption;
+  *   - a held ambulance always gets its green, with the worst case wait;
+  *   - every phase is reachable.
+  *
+  * Time is explored in steps of the greatest common divisor of the phase
+  * durations, the controller only decides on multiples of it, so presses
+  * between two steps behave like presses on the step.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+
+/* The controller tables are static, the explorer reads its durations */
+#include "controller.c"
+
+#define EDGE_TIME  0          // Successor after one time step
+#define EDGES      5          // Time, then one per button
+
+#define OPEN_PRINCIPAL  (LAMP_VERDE_PRINCIPAL | LAMP_AMARELO_PRINCIPAL)
+#define OPEN_SECUNDARIA (LAMP_VERDE_SECUNDARIA | LAMP_AMARELO_SECUNDARIA)
+#define OPEN_PEDESTRE   LAMP_VERDE_PEDESTRE
+#define REQ_AMB         (REQ_AMB_PRI | REQ_AMB_SEC)
+
+static const uint8_t buttons[EDGES - 1] =
+{
+  PEDESTRE, CARRO_SECUNDARIA, AMBULANCIA_PRINCIPAL, AMBULANCIA_SECUNDARIA
+};
+
+/* Presses allowed while checking a liveness property, the ambulances toggle
+   the preemptions and are left out.*/
+#define EDGES_NO_AMB ((1 << EDGE_TIME) | (1 << 1) | (1 << 2))
+
+/*
+  * States are packed in 32 bits: phase (4), lamps (8), pending (4) and the
+  * elapsed time in steps (16). The hash set maps them to their index in the
+  * states array, in BFS order.
+*/
+typedef uint32_t state_t;
+
+_Static_assert(PH_COUNT <= 16 && REQ_COUNT <= 16, "controller state wider than the packing");
+
+static uint16_t step_ms, cap_ms, period_ms;
+static state_t *states;
+static uint32_t (*edges)[EDGES];
+static uint32_t count, capacity;
+static uint32_t *table;        // Open addressing, index + 1, 0 is empty
+static uint32_t table_mask;
+static unsigned violations;
+
+static state_t encode(const controller_t *ctl)
+{
+  return (state_t)ctl->phase | (state_t)ctl->lamps << 4 |
+         (state_t)ctl->pending << 12 | (state_t)(ctl->elapsed / step_ms) << 16;
+}
+
+static void decode(state_t s, controller_t *ctl)
+{
+  ctl->phase = s & 0x0F;
+  ctl->lamps = (s >> 4) & 0xFF;
+  ctl->pending = (s >> 12) & 0x0F;
+  ctl->elapsed = (uint16_t)((s >> 16) * step_ms);
+}
+
+/* Past every phase limit only the blink parity of the time matters */
+static void normalize(controller_t *ctl)
+{
+  if (ctl->elapsed > cap_ms)
+    ctl->elapsed = cap_ms + (ctl->elapsed - cap_ms) % period_ms;
+}
+
+static uint32_t hash(state_t s)
+{
+  s ^= s >> 16;
+  s *= 0x7FEB352DU;
+  s ^= s >> 15;
+  s *= 0x846CA68BU;
+  s ^= s >> 16;
+  return s;
+}
+
+static void tableGrow(void)
+{
+  uint32_t size = table_mask ? 2 * (table_mask + 1) : 1 << 16;
+
+  free(table);
+  table = calloc(size, sizeof(*table));
+  table_mask = size - 1;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t h = hash(states[i]) & table_mask;
+
+    while (table[h])
+      h = (h + 1) & table_mask;
+    table[h] = i + 1;
+  }
+}
+
+/* Index of a state, added to the states array when new */
+static uint32_t intern(state_t s)
+{
+  uint32_t h;
+
+  if (2 * (count + 1) > table_mask + 1)
+    tableGrow();
+
+  for (h = hash(s) & table_mask; table[h]; h = (h + 1) & table_mask)
+  {
+    if (states[table[h] - 1] == s)
+      return table[h] - 1;
+  }
+
+  if (count == capacity)
+  {
+    capacity = capacity ? 2 * capacity : 1 << 16;
+    states = realloc(states, capacity * sizeof(*states));
+    edges = realloc(edges, capacity * sizeof(*edges));
+  }
+  states[count] = s;
+  table[h] = count + 1;
+  return count++;
+}
+
+static void report(const char *what, state_t s)
+{
+  controller_t ctl;
+
+  decode(s, &ctl);
+  if (violations++ < 20)
+    printf("VIOLATION %s: phase %u lamps 0x%02x pending 0x%x elapsed %u ms\n",
+           what, ctl.phase, ctl.lamps, ctl.pending, ctl.elapsed);
+}
+
+static void checkState(state_t s)
+{
+  uint8_t lamps = (s >> 4) & 0xFF;
+  uint8_t open = ((lamps & OPEN_PRINCIPAL) != 0) + ((lamps & OPEN_SECUNDARIA) != 0) +
+                 ((lamps & OPEN_PEDESTRE) != 0);
+
+  if (open > 1)
+    report("conflicting heads open", s);
+  if ((lamps & OPEN_PRINCIPAL) && (lamps & LAMP_VERMELHO_PRINCIPAL))
+    report("principal green and red", s);
+  if ((lamps & OPEN_SECUNDARIA) && (lamps & LAMP_VERMELHO_SECUNDARIA))
+    report("secundaria green and red", s);
+  if ((lamps & LAMP_VERDE_PEDESTRE) && (lamps & LAMP_VERMELHO_PEDESTRE))
+    report("pedestre green and red", s);
+}
+
+static void checkEdge(state_t from, state_t to)
+{
+  uint8_t before = (from >> 4) & 0xFF, after = (to >> 4) & 0xFF;
+
+  if ((before & LAMP_VERDE_PRINCIPAL) && (after & LAMP_VERMELHO_PRINCIPAL))
+    report("principal green to red without yellow", from);
+  if ((before & LAMP_VERDE_SECUNDARIA) && (after & LAMP_VERMELHO_SECUNDARIA))
+    report("secundaria green to red without yellow", from);
+}
+
+static void explore(void)
+{
+  controller_t ctl;
+
+  ctlInit(&ctl);
+  intern(encode(&ctl));
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    state_t s = states[i];
+
+    checkState(s);
+    for (uint8_t e = 0; e < EDGES; e++)
+    {
+      uint32_t next;
+
+      decode(s, &ctl);
+      if (e == EDGE_TIME)
+      {
+        if (ctlWaitMs(&ctl) == CTL_WAIT_NONE)
+        {
+          edges[i][e] = i;
+          continue;
+        }
+        ctlTick(&ctl, step_ms);
+      }
+      else
+      {
+        ctlInput(&ctl, buttons[e - 1]);
+        ctlTick(&ctl, 0);
+      }
+      normalize(&ctl);
+
+      next = intern(encode(&ctl));
+      edges[i][e] = next;
+      checkEdge(s, states[next]);
+    }
+  }
+}
+
+/*
+  * Worst case time spent in the states matching waiting() before leaving
+  * them, over every path of the allowed edges. A cycle of time steps inside
+  * them means the wait can last forever.
+*/
+typedef int (*waiting_t)(state_t s);
+
+static int waitPed(state_t s)
+{
+  return ((s >> 12) & REQ_PEDESTRE) && !((s >> 12) & REQ_AMB);
+}
+
+static int waitCar(state_t s)
+{
+  return ((s >> 12) & REQ_CARRO) && !((s >> 12) & REQ_AMB);
+}
+
+static int waitAmbPri(state_t s)
+{
+  return ((s >> 12) & REQ_AMB) == REQ_AMB_PRI && !((s >> 4) & LAMP_VERDE_PRINCIPAL);
+}
+
+static int waitAmbSec(state_t s)
+{
+  return ((s >> 12) & REQ_AMB) == REQ_AMB_SEC && !((s >> 4) & LAMP_VERDE_SECUNDARIA);
+}
+
+#define UNVISITED UINT32_MAX
+#define ON_STACK  (UINT32_MAX - 1)
+#define FOREVER   (UINT32_MAX - 2)
+
+static uint32_t worstWait(waiting_t waiting, unsigned allowed, state_t *starved)
+{
+  uint32_t *dist = malloc(count * sizeof(*dist));
+  uint32_t *stack = malloc(count * sizeof(*stack));
+  uint8_t *edge = malloc(count);
+  uint32_t worst = 0;
+
+  for (uint32_t i = 0; i < count; i++)
+    dist[i] = UNVISITED;
+
+  for (uint32_t root = 0; root < count && worst != FOREVER; root++)
+  {
+    uint32_t sp = 0;
+
+    if (dist[root] != UNVISITED || !waiting(states[root]))
+      continue;
+
+    stack[sp++] = root;
+    dist[root] = ON_STACK;
+    edge[root] = 0;
+    while (sp > 0)
+    {
+      uint32_t i = stack[sp - 1];
+
+      /* Nothing is due without a new press, the wait never ends */
+      if (edges[i][EDGE_TIME] == i)
+      {
+        *starved = states[i];
+        worst = FOREVER;
+        break;
+      }
+
+      if (edge[i] < EDGES)
+      {
+        uint8_t e = edge[i]++;
+        uint32_t next = edges[i][e];
+
+        if (!(allowed & (1 << e)) || next == i || !waiting(states[next]))
+          continue;
+        if (dist[next] == ON_STACK)
+        {
+          *starved = states[next];
+          worst = FOREVER;
+          break;
+        }
+        if (dist[next] == UNVISITED)
+        {
+          stack[sp++] = next;
+          dist[next] = ON_STACK;
+          edge[next] = 0;
+        }
+        continue;
+      }
+
+      /* All the successors are done, the longest of them plus this step */
+      dist[i] = 0;
+      for (uint8_t e = 0; e < EDGES; e++)
+      {
+        uint32_t next = edges[i][e], d;
+
+        if (!(allowed & (1 << e)) || next == i || !waiting(states[next]))
+          continue;
+        d = dist[next] + (e == EDGE_TIME ? step_ms : 0);
+        if (d > dist[i])
+          dist[i] = d;
+      }
+      /* Leaving the waiting states takes the last step */
+      if (allowed & (1 << EDGE_TIME) && edges[i][EDGE_TIME] != i &&
+          !waiting(states[edges[i][EDGE_TIME]]) && dist[i] < step_ms)
+        dist[i] = step_ms;
+      if (dist[i] > worst)
+        worst = dist[i];
+      sp--;
+    }
+  }
+
+  free(dist);
+  free(stack);
+  free(edge);
+  return worst;
+}
+
+static uint16_t gcd(uint16_t a, uint16_t b)
+{
+  while (b)
+  {
+    uint16_t t = a % b;
+
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* Time step, limit and blink period of the explored time from the tables */
+static void timing(void)
+{
+  uint16_t blink = 1;
+
+  step_ms = 0;
+  cap_ms = 0;
+  for (uint8_t p = 0; p < PH_COUNT; p++)
+  {
+    uint16_t values[3] = {phases[p].ms, phases[p].preempt_ms, phases[p].blink_ms};
+
+    for (int v = 0; v < 3; v++)
+    {
+      if (values[v] == 0)
+        continue;
+      step_ms = gcd(step_ms, values[v]);
+      if (v < 2 && values[v] > cap_ms)
+        cap_ms = values[v];
+    }
+    if (phases[p].blink_ms)
+      blink = (uint16_t)(blink / gcd(blink, 2 * phases[p].blink_ms) * 2 * phases[p].blink_ms);
+  }
+  period_ms = (uint16_t)(blink / gcd(blink, step_ms) * step_ms);
+  cap_ms = (uint16_t)((cap_ms + period_ms - 1) / period_ms * period_ms);
+}
+
+static void liveness(const char *name, waiting_t waiting)
+{
+  state_t starved = 0;
+  uint32_t worst = worstWait(waiting, EDGES_NO_AMB, &starved);
+
+  if (worst == FOREVER)
+    report(name, starved);
+  else
+    printf("%-22s worst case wait %u ms\n", name, worst);
+}
+
+int main(void)
+{
+  static const char * const names[PH_COUNT] = {PH_NAMES};
+  struct timespec t0, t1;
+  uint16_t reached = 0;
+  unsigned long transitions = 0;
+  double wall;
+
+  timing();
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  explore();
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    reached |= 1 << (states[i] & 0x0F);
+    for (uint8_t e = 0; e < EDGES; e++)
+      transitions += edges[i][e] != i;
+  }
+
+  printf("time step %u ms, explored %u states and %lu transitions in %.3f s (%.3g states/s)\n",
+         step_ms, count, transitions, wall, count / wall);
+
+  for (uint8_t p = 0; p < PH_COUNT; p++)
+  {
+    if (!(reached & (1 << p)))
+    {
+      printf("VIOLATION phase %s unreachable\n", names[p]);
+      violations++;
+    }
+  }
+
+  liveness("pedestre request", waitPed);
+  liveness("carro request", waitCar);
+  liveness("ambulancia principal", waitAmbPri);
+  liveness("ambulancia secundaria", waitAmbSec);
+
+  printf("%u violation(s)\n", violations);
+  return violations ? 1 : 0;
+}
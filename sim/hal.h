@@ -0,0 +1,55 @@
+/*
+  * Simulated PAL for the host build, records every pad write with the
+  * virtual time of the simulation clock.
+*/
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Every simulated intersection gets its own copy of the board ports */
+#define SIM_INTERSECTIONS_MAX 64
+#define SIM_BOARD_PORTS       3
+
+typedef struct
+{
+  const char *name;
+  uint8_t unit;     // Intersection owning the port
+  uint8_t latch;    // Output latch
+  uint8_t outputs;  // Pads configured as outputs
+} sim_port_t;
+
+typedef sim_port_t *ioportid_t;
+
+extern sim_port_t sim_ports[SIM_BOARD_PORTS * SIM_INTERSECTIONS_MAX];
+
+#define IOPORT2 (&sim_ports[0])
+#define IOPORT3 (&sim_ports[1])
+#define IOPORT4 (&sim_ports[2])
+
+/* Port of another intersection, same position as port on the board */
+#define SIM_UNIT_PORT(port, unit) ((port) + SIM_BOARD_PORTS * (unit))
+
+#define PAL_LOW                   0
+#define PAL_HIGH                  1
+#define PAL_MODE_INPUT_PULLUP     1
+#define PAL_MODE_OUTPUT_PUSHPULL  2
+#define PAL_PORT_BIT(n)           ((uint8_t)(1U << (n)))
+
+void palSetPadMode(ioportid_t port, uint8_t pad, uint8_t mode);
+void palSetPad(ioportid_t port, uint8_t pad);
+void palClearPad(ioportid_t port, uint8_t pad);
+void palTogglePad(ioportid_t port, uint8_t pad);
+void palWriteGroup(ioportid_t port, uint8_t mask, uint8_t offset, uint8_t bits);
+uint8_t palReadLatch(ioportid_t port);
+
+/* Pad write recording */
+typedef void (*sim_pal_trace_t)(ioportid_t port, uint8_t pad, uint8_t level);
+
+extern uint32_t sim_pal_writes;
+void simPalInit(void);
+void simPalSetTrace(sim_pal_trace_t trace);
+
+#endif
@@ -0,0 +1,356 @@
+/*
+  * Throughput of the dual ring controller against serial phases.
+  *
+  * A four approach intersection with protected left turns (NEMA phases 1, 3,
+  * 5, 7) and through movements with pedestrian crossings (2, 4, 6, 8) runs
+  * the same phase timings twice: laid out in two rings, where the
+  * compatible movements run together, and in a single ring, one movement
+  * at a time like the phases of controller.c. Vehicles arrive at random on
+  * every phase, place a detector call and leave at the saturation headway
+  * while their phase is green.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "sim_clock.h"
+#include "nema.h"
+
+#define HEADWAY_MS 2000   // Saturation flow, 1800 vehicles per hour of green
+#define QUEUE_MAX  4096
+
+#define LEFT(min, max)    {min, max, 2000, 3000, 1000, 0, 0, 0, 0}
+#define THROUGH(g, flags) {10000, 40000, 3000, 4000, 1500, 7000, 12000, g, flags}
+
+static const nema_cfg_t dual_ring =
+{
+  .phase =
+  {
+    [0] = LEFT(5000, 15000), [1] = THROUGH(0, NEMA_RECALL | NEMA_PED),
+    [4] = LEFT(5000, 15000), [5] = THROUGH(0, NEMA_RECALL | NEMA_PED),
+    [2] = LEFT(5000, 15000), [3] = THROUGH(1, NEMA_PED),
+    [6] = LEFT(5000, 15000), [7] = THROUGH(1, NEMA_PED),
+  },
+  .seq =
+  {
+    {0, 1, 2, 3, NEMA_NONE, NEMA_NONE, NEMA_NONE, NEMA_NONE},
+    {4, 5, 6, 7, NEMA_NONE, NEMA_NONE, NEMA_NONE, NEMA_NONE},
+  },
+};
+
+static nema_cfg_t serial_ring;
+
+typedef struct
+{
+  double per_hour;         // Vehicles per hour
+  double ped_per_hour;
+  uint64_t arrived[QUEUE_MAX];
+  uint32_t head, count;
+  uint64_t next_free;      // Earliest departure, saturation headway
+  sim_timer_t arrival, ped, departure;
+  uint64_t served, delay_total, delay_max, overflow;
+} approach_t;
+
+typedef struct
+{
+  nema_t ctl;
+  sim_timer_t timer;
+  uint16_t wait;
+  uint64_t armed_at;
+  uint32_t image;
+  uint64_t callbacks, greens, walks;
+  approach_t phase[NEMA_PHASES];
+} bench_t;
+
+static bench_t bench;
+static uint64_t rng_state;
+
+static double rngUniform(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static uint32_t rngExpMs(double per_hour)
+{
+  return (uint32_t)(-log(rngUniform()) * 3600000.0 / per_hour) + 1;
+}
+
+static void departure(void *arg);
+
+static void depart(approach_t *ap)
+{
+  uint64_t delay = simNow() - ap->arrived[ap->head];
+
+  ap->head = (ap->head + 1) % QUEUE_MAX;
+  ap->count--;
+  ap->served++;
+  ap->delay_total += delay;
+  if (delay > ap->delay_max)
+    ap->delay_max = delay;
+  ap->next_free = simNow() + HEADWAY_MS;
+}
+
+static void scheduleDeparture(approach_t *ap)
+{
+  if (ap->count > 0 && !ap->departure.armed)
+    simTimerSet(&ap->departure, (uint32_t)(ap->next_free > simNow() ? ap->next_free - simNow() : 0),
+                departure, ap);
+}
+
+/* Two phases of a ring or of different groups never show green or yellow together */
+static void checkConflicts(void)
+{
+  const nema_cfg_t *cfg = bench.ctl.cfg;
+
+  for (uint8_t r = 0; r < NEMA_RINGS; r++)
+  {
+    for (uint8_t i = 0; i < NEMA_SEQ; i++)
+    {
+      uint8_t a = cfg->seq[r][i];
+
+      if (a == NEMA_NONE || nemaSignal(&bench.ctl, a) == NEMA_RED)
+        continue;
+      for (uint8_t b = 0; b < NEMA_PHASES; b++)
+      {
+        if (b == a || nemaSignal(&bench.ctl, b) == NEMA_RED)
+          continue;
+        if (cfg->phase[b].group != cfg->phase[a].group || memchr(cfg->seq[r], b, NEMA_SEQ))
+        {
+          fprintf(stderr, "phases %d and %d open together at %llu ms\n", a + 1, b + 1,
+                  (unsigned long long)simNow());
+          exit(1);
+        }
+      }
+    }
+  }
+}
+
+static void signalsChanged(void)
+{
+  uint32_t image = nemaImage(&bench.ctl);
+
+  checkConflicts();
+
+  for (uint8_t i = 0; i < NEMA_PHASES; i++)
+  {
+    approach_t *ap = &bench.phase[i];
+    uint8_t was = (bench.image >> (2 * i)) & 3, now = nemaSignal(&bench.ctl, i);
+
+    if (was != NEMA_GREEN && now == NEMA_GREEN)
+    {
+      bench.greens++;
+      ap->next_free = simNow() + HEADWAY_MS;
+      scheduleDeparture(ap);
+    }
+    /* Presence detection, the vehicles left waiting keep calling */
+    if (was == NEMA_GREEN && now != NEMA_GREEN && ap->count > 0)
+      nemaCall(&bench.ctl, i);
+    if (((bench.image >> (2 * (NEMA_PHASES + i))) & 3) != NEMA_WALK &&
+        nemaPedSignal(&bench.ctl, i) == NEMA_WALK)
+      bench.walks++;
+  }
+  bench.image = image;
+}
+
+static void phaseTick(void *arg);
+
+/* Mirror of the firmware PhaseRun */
+static void run(uint16_t ms)
+{
+  if (nemaTick(&bench.ctl, ms) & NEMA_SIGNALS_CHANGED)
+  {
+    signalsChanged();
+    /* Calls placed by the presence detection are taken at once */
+    if (nemaTick(&bench.ctl, 0) & NEMA_SIGNALS_CHANGED)
+      signalsChanged();
+  }
+
+  simTimerReset(&bench.timer);
+  bench.wait = nemaWaitMs(&bench.ctl);
+  if (bench.wait == NEMA_WAIT_NONE)
+  {
+    bench.wait = 0;
+    return;
+  }
+  bench.armed_at = simNow();
+  simTimerSet(&bench.timer, bench.wait, phaseTick, NULL);
+}
+
+static void phaseTick(void *arg)
+{
+  (void)arg;
+
+  bench.callbacks++;
+  run(bench.wait);
+}
+
+static void input(void)
+{
+  run(bench.wait ? (uint16_t)(simNow() - bench.armed_at) : 0);
+}
+
+static void departure(void *arg)
+{
+  approach_t *ap = arg;
+
+  if (nemaSignal(&bench.ctl, (uint8_t)(ap - bench.phase)) != NEMA_GREEN || ap->count == 0)
+    return;
+  depart(ap);
+  scheduleDeparture(ap);
+
+  /* The queue still over the detector extends the green */
+  if (ap->count > 0)
+  {
+    nemaCall(&bench.ctl, (uint8_t)(ap - bench.phase));
+    input();
+  }
+}
+
+static void arrival(void *arg)
+{
+  approach_t *ap = arg;
+  uint8_t phase = (uint8_t)(ap - bench.phase);
+
+  if (ap->count == QUEUE_MAX)
+    ap->overflow++;
+  else
+  {
+    ap->arrived[(ap->head + ap->count) % QUEUE_MAX] = simNow();
+    ap->count++;
+    if (nemaSignal(&bench.ctl, phase) == NEMA_GREEN)
+      scheduleDeparture(ap);
+  }
+  nemaCall(&bench.ctl, phase);
+  input();
+  simTimerSet(&ap->arrival, rngExpMs(ap->per_hour), arrival, ap);
+}
+
+static void pedestrian(void *arg)
+{
+  approach_t *ap = arg;
+
+  nemaPedCall(&bench.ctl, (uint8_t)(ap - bench.phase));
+  input();
+  simTimerSet(&ap->ped, rngExpMs(ap->ped_per_hour), pedestrian, ap);
+}
+
+/*
+  * Max green after a long rest: the main through green rests longer than a
+  * 16 bits ms count (65.5 s) with its own detector extending it, then a
+  * side street call arrives. The green has to run max_green_ms after that
+  * call, neither ending on it nor at a saturated time.
+*/
+static void checkMaxGreen(void)
+{
+  const uint32_t rest_ms = 70000, step_ms = 500;
+  uint32_t max = dual_ring.phase[1].max_green_ms, t;
+  nema_t ctl;
+
+  nemaInit(&ctl, &dual_ring);
+  for (t = 0; t <= rest_ms + 2 * max; t += step_ms)
+  {
+    if (t != 0)
+      nemaTick(&ctl, (uint16_t)step_ms);
+    if (nemaSignal(&ctl, 1) != NEMA_GREEN)
+      break;
+    nemaCall(&ctl, 1);
+    if (t == rest_ms)
+      nemaCall(&ctl, 3);
+    nemaTick(&ctl, 0);
+    if (nemaSignal(&ctl, 1) != NEMA_GREEN)
+      break;
+  }
+
+  if (t != rest_ms + max)
+  {
+    fprintf(stderr, "phase 2 green ended %lu ms after the conflicting call, max green %lu ms\n",
+            (unsigned long)(t - rest_ms), (unsigned long)max);
+    exit(1);
+  }
+}
+
+static void simulate(const char *name, const nema_cfg_t *cfg, double hours,
+                     double load, uint64_t seed)
+{
+  static const double through = 500, left = 120, side = 300, side_left = 80, peds = 30;
+  static const double rates[NEMA_PHASES] = {left, through, side_left, side,
+                                            left, through, side_left, side};
+  uint64_t served = 0, delay = 0, max = 0, waiting = 0, overflow = 0;
+
+  memset(&bench, 0, sizeof(bench));
+  rng_state = seed;
+  simClockInit(0);
+  nemaInit(&bench.ctl, cfg);
+  bench.image = nemaImage(&bench.ctl);
+  run(0);
+
+  for (uint8_t i = 0; i < NEMA_PHASES; i++)
+  {
+    approach_t *ap = &bench.phase[i];
+
+    ap->per_hour = rates[i] * load;
+    simTimerSet(&ap->arrival, rngExpMs(ap->per_hour), arrival, ap);
+    if (cfg->phase[i].flags & NEMA_PED)
+    {
+      ap->ped_per_hour = peds;
+      simTimerSet(&ap->ped, rngExpMs(ap->ped_per_hour), pedestrian, ap);
+    }
+  }
+
+  simRunUntil((uint64_t)(hours * 3600000.0));
+
+  for (uint8_t i = 0; i < NEMA_PHASES; i++)
+  {
+    approach_t *ap = &bench.phase[i];
+
+    served += ap->served;
+    delay += ap->delay_total;
+    waiting += ap->count;
+    overflow += ap->overflow;
+    if (ap->delay_max > max)
+      max = ap->delay_max;
+  }
+
+  printf("%-10s %9.0f %8.1f s %8.1f s %8llu %8.0f %9.0f %9.0f\n", name,
+         served / hours, served ? delay / 1000.0 / served : 0.0, max / 1000.0,
+         (unsigned long long)(waiting + overflow), bench.walks / hours,
+         bench.greens / hours, bench.callbacks / hours);
+}
+
+int main(int argc, char **argv)
+{
+  double hours = 24, load = 1;
+  uint64_t seed = 0x2545F4914F6CDD1DULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:l:r:")) != -1)
+  {
+    switch (opt)
+    {
+      case 't': hours = atof(optarg); break;
+      case 'l': load = atof(optarg); break;
+      case 'r': seed = strtoull(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-t simulated hours] [-l arrival rate multiplier] [-r seed]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  /* The same phases one at a time: a single ring, the barrier groups kept */
+  serial_ring = dual_ring;
+  memset(serial_ring.seq, NEMA_NONE, sizeof(serial_ring.seq));
+  memcpy(serial_ring.seq[0], (const uint8_t[]){0, 1, 4, 5, 2, 3, 6, 7}, NEMA_SEQ);
+
+  checkMaxGreen();
+
+  printf("layout         veh/h   mean delay   max delay  waiting  walks/h  greens/h   timer/h\n");
+  simulate("dual ring", &dual_ring, hours, load, seed);
+  simulate("serial", &serial_ring, hours, load, seed);
+
+  return 0;
+}
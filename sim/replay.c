@@ -0,0 +1,204 @@
+/*
+  * Replay of a recorded input trace.
+  *
+  * Runs the button presses of a trace through the firmware engine (press
+  * coalescing, event queue, collector, controller and phase timer, see
+  * sim_engine.h) on the virtual clock, unpaced, and prints the resulting
+  * signal timeline, so two firmware versions or a field complaint can be
+  * compared with diff.
+  *
+  * Trace lines are "<ms> <intersection> <button>", the button by name
+  * (PEDESTRE, CARRO_SECUNDARIA, AMBULANCIA_PRINCIPAL, AMBULANCIA_SECUNDARIA)
+  * or by PORTB pad, '#' starts a comment. tools/tlm_decode.py --trace writes
+  * them from the ARRIVAL telemetry records, which are debounced presses.
+  * With -l the press-to-green latency histograms follow, in the serial
+  * monitor format.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "sim_clock.h"
+#include "sim_engine.h"
+#include "controller.h"
+#include "lamps.h"
+
+static const char * const phase_names[PH_COUNT] = {PH_NAMES};
+
+static const struct
+{
+  const char *name;
+  uint8_t pad;
+} buttons[] =
+{
+  {"PEDESTRE",              PEDESTRE},
+  {"CARRO_SECUNDARIA",      CARRO_SECUNDARIA},
+  {"AMBULANCIA_PRINCIPAL",  AMBULANCIA_PRINCIPAL},
+  {"AMBULANCIA_SECUNDARIA", AMBULANCIA_SECUNDARIA},
+};
+
+#define BUTTONS_NUM (sizeof(buttons) / sizeof(buttons[0]))
+
+static int units_num = 1;
+static uint64_t presses, coalesced, dropped, transitions;
+static int verbose_lamps = 1;
+static int latency_lines;
+
+static void timeline(const intersection_t *isp, const char *what)
+{
+  uint64_t t = simNow();
+
+  printf("%8llu.%03llu %u %-18s lamps 0x%02x %s\n", (unsigned long long)(t / 1000),
+         (unsigned long long)(t % 1000), isp->id, phase_names[isp->ctl.phase],
+         isp->ctl.lamps, what);
+}
+
+/* The firmware Process Event writes the lamps and times the greens */
+static void changed(intersection_t *isp, uint8_t changes)
+{
+  if (changes & CTL_LAMPS_CHANGED)
+  {
+    lampsWrite(isp->lamps, isp->ctl.lamps);
+    latLamps(&isp->lat, isp->ctl.lamps, (uint32_t)chVTGetTimeStampI());
+  }
+  if (changes & CTL_PHASE_CHANGED)
+  {
+    transitions++;
+    timeline(isp, "phase");
+  }
+  else if ((changes & CTL_LAMPS_CHANGED) && verbose_lamps)
+    timeline(isp, "blink");
+}
+
+/* The firmware buttons interrupt, the collector runs on the next dispatch */
+static void press(intersection_t *isp, uint8_t pad)
+{
+  uint8_t bit = PAL_PORT_BIT(pad);
+  uint64_t drops = sim_dropped;
+
+  presses++;
+  if ((isp->queued & bit) && (BUTTONS_TOGGLE & bit) == 0)
+    coalesced++;
+  engPressI(isp, pad, chVTGetTimeStampI());
+  dropped += sim_dropped - drops;
+}
+
+static int button(const char *name)
+{
+  char *end;
+  long pad = strtol(name, &end, 10);
+
+  if (*end == '\0' && end != name)
+    return pad >= 0 && pad < BUTTONS_PADS && (BUTTONS_MASK & (1 << pad)) ? (int)pad : -1;
+
+  for (size_t i = 0; i < BUTTONS_NUM; i++)
+  {
+    if (strcmp(name, buttons[i].name) == 0)
+      return buttons[i].pad;
+  }
+  return -1;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-n intersections] [-e end seconds] [-q] [-l] [trace]\n"
+          "  -e  keeps running after the last press (default 60 s)\n"
+          "  -q  prints the phase changes only, not the blink toggles\n"
+          "  -l  prints the latency histograms at the end\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  double tail = 60;
+  FILE *in = stdin;
+  char line[128];
+  unsigned long lineno = 0;
+  uint64_t last = 0;
+  struct timespec t0, t1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:e:ql")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': units_num = atoi(optarg); break;
+      case 'e': tail = atof(optarg); break;
+      case 'q': verbose_lamps = 0; break;
+      case 'l': latency_lines = 1; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (units_num < 1 || units_num > SIM_INTERSECTIONS_MAX)
+  {
+    fprintf(stderr, "%s: 1 to %d intersections\n", argv[0], SIM_INTERSECTIONS_MAX);
+    return 1;
+  }
+  if (optind < argc && strcmp(argv[optind], "-") != 0 && (in = fopen(argv[optind], "r")) == NULL)
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  simClockInit(0);
+  simPalInit();
+  simEngineInit(units_num, changed);
+  for (int i = 0; i < units_num; i++)
+  {
+    lampsWrite(sim_units[i].lamps, sim_units[i].ctl.lamps);
+    latLamps(&sim_units[i].lat, sim_units[i].ctl.lamps, (uint32_t)chVTGetTimeStampI());
+    timeline(&sim_units[i], "start");
+  }
+
+  while (fgets(line, sizeof(line), in))
+  {
+    unsigned long long ms;
+    unsigned id;
+    char name[32];
+    int pad;
+
+    lineno++;
+    if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+      continue;
+    if (sscanf(line, "%llu %u %31s", &ms, &id, name) != 3 || (pad = button(name)) < 0 ||
+        id >= (unsigned)units_num || ms < last)
+    {
+      fprintf(stderr, "%s:%lu: bad or out of order press: %s", optind < argc ? argv[optind] : "stdin",
+              lineno, line);
+      return 1;
+    }
+
+    simRunUntil(ms);
+    press(&sim_units[id], (uint8_t)pad);
+    last = ms;
+  }
+
+  simRunUntil(last + (uint64_t)(tail * 1000.0));
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  for (int i = 0; latency_lines && i < units_num; i++)
+  {
+    for (int c = 0; c < LAT_CLASSES; c++)
+    {
+      const lat_hist_t *hp = &sim_units[i].lat.hist[c];
+
+      printf("L %d %d %u", i, c, hp->max_ms);
+      for (int b = 0; b < LAT_BUCKETS; b++)
+        printf(" %u", hp->count[b]);
+      printf("\n");
+    }
+  }
+
+  fprintf(stderr, "replayed %.3f s of trace in %.3f s wall: %llu presses, %llu coalesced, "
+          "%llu dropped, %llu phase changes\n", simNow() / 1000.0,
+          (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+          (unsigned long long)presses, (unsigned long long)coalesced,
+          (unsigned long long)dropped, (unsigned long long)transitions);
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sim_clock.h"
+
+static sim_timer_t *heap[SIM_TIMERS_MAX];
+static uint32_t heap_size;
+static uint64_t now_ms, seq, dispatched;
+static double speedup;
+static struct timespec wall_start;
+
+static bool simBefore(const sim_timer_t *a, const sim_timer_t *b)
+{
+  return a->due < b->due || (a->due == b->due && a->seq < b->seq);
+}
+
+static void simHeapPlace(sim_timer_t *tp, uint32_t i)
+{
+  heap[i] = tp;
+  tp->index = i;
+}
+
+static void simSiftUp(uint32_t i)
+{
+  sim_timer_t *tp = heap[i];
+
+  while (i > 0 && simBefore(tp, heap[(i - 1) / 2]))
+  {
+    simHeapPlace(heap[(i - 1) / 2], i);
+    i = (i - 1) / 2;
+  }
+  simHeapPlace(tp, i);
+}
+
+static void simSiftDown(uint32_t i)
+{
+  sim_timer_t *tp = heap[i];
+
+  for (;;)
+  {
+    uint32_t c = 2 * i + 1;
+
+    if (c >= heap_size)
+      break;
+    if (c + 1 < heap_size && simBefore(heap[c + 1], heap[c]))
+      c++;
+    if (!simBefore(heap[c], tp))
+      break;
+    simHeapPlace(heap[c], i);
+    i = c;
+  }
+  simHeapPlace(tp, i);
+}
+
+static void simHeapRemove(uint32_t i)
+{
+  heap_size--;
+  if (i == heap_size)
+    return;
+
+  /* The last timer fills the hole and moves towards its place */
+  simHeapPlace(heap[heap_size], i);
+  if (i > 0 && simBefore(heap[i], heap[(i - 1) / 2]))
+    simSiftUp(i);
+  else
+    simSiftDown(i);
+}
+
+void simClockInit(double speed)
+{
+  heap_size = 0;
+  now_ms = seq = dispatched = 0;
+  speedup = speed;
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+}
+
+uint64_t simNow(void)
+{
+  return now_ms;
+}
+
+uint64_t simDispatched(void)
+{
+  return dispatched;
+}
+
+void simTimerReset(sim_timer_t *tp)
+{
+  if (!tp->armed)
+    return;
+
+  simHeapRemove(tp->index);
+  tp->armed = false;
+}
+
+void simTimerSet(sim_timer_t *tp, uint32_t delay_ms, sim_func_t func, void *arg)
+{
+  simTimerReset(tp);
+
+  if (heap_size >= SIM_TIMERS_MAX)
+  {
+    fprintf(stderr, "sim: more than %d armed timers\n", SIM_TIMERS_MAX);
+    exit(1);
+  }
+
+  tp->due = now_ms + delay_ms;
+  tp->seq = seq++;
+  tp->func = func;
+  tp->arg = arg;
+  tp->armed = true;
+  simHeapPlace(tp, heap_size++);
+  simSiftUp(tp->index);
+}
+
+/* Sleeps until the wall clock catches up with the virtual time */
+static void simPace(uint64_t t_ms)
+{
+  struct timespec target;
+  double s;
+
+  if (speedup <= 0)
+    return;
+
+  s = (double)t_ms / 1000.0 / speedup;
+  target.tv_sec = wall_start.tv_sec + (time_t)s;
+  target.tv_nsec = wall_start.tv_nsec + (long)((s - (double)(time_t)s) * 1e9);
+  if (target.tv_nsec >= 1000000000L)
+  {
+    target.tv_sec++;
+    target.tv_nsec -= 1000000000L;
+  }
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+}
+
+void simRunUntil(uint64_t end_ms)
+{
+  while (heap_size > 0 && heap[0]->due <= end_ms)
+  {
+    sim_timer_t *tp = heap[0];
+
+    simPace(tp->due);
+    now_ms = tp->due;
+    simHeapRemove(0);
+    tp->armed = false;
+    dispatched++;
+    tp->func(tp->arg);
+  }
+
+  now_ms = end_ms;
+}
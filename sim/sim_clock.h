@@ -0,0 +1,36 @@
+/*
+  * Virtual clock of the host build, a discrete-event scheduler of one-shot
+  * timers in milliseconds of simulated time, optionally paced against the
+  * wall clock. Armed timers are kept in a fixed size binary heap.
+*/
+
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*sim_func_t)(void *arg);
+
+#if !defined(SIM_TIMERS_MAX)
+#define SIM_TIMERS_MAX 1024
+#endif
+
+typedef struct
+{
+  uint64_t due;     // Expiration, virtual milliseconds
+  uint64_t seq;     // Arming order, timers with the same expiration run FIFO
+  sim_func_t func;
+  void *arg;
+  uint32_t index;   // Heap slot, valid while armed
+  bool armed;
+} sim_timer_t;
+
+void simClockInit(double speed);
+uint64_t simNow(void);
+void simTimerSet(sim_timer_t *tp, uint32_t delay_ms, sim_func_t func, void *arg);
+void simTimerReset(sim_timer_t *tp);
+void simRunUntil(uint64_t end_ms);
+uint64_t simDispatched(void);
+
+#endif
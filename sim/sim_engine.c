@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+#include "sim_engine.h"
+#include "evqueue.h"
+
+intersection_t sim_units[SIM_INTERSECTIONS_MAX];
+uint64_t sim_posted, sim_dropped;  // Event queue messages
+uint64_t sim_expiries;             // Phase timer callbacks, keepalives included
+systimestamp_t sim_laststamp;      // Kernel time stamp, see ch.h
+
+static lamp_map_t sim_lamps[SIM_INTERSECTIONS_MAX];
+static int sim_units_num;
+static sim_changed_t sim_changed;
+static sim_timer_t dispatch_timer;
+
+/* The collector, drains the event queue */
+static void simDispatch(void *arg)
+{
+  uint8_t msg;
+
+  (void)arg;
+  while (evqGet(&msg))
+  {
+    if (EVQ_ID(msg) < sim_units_num)
+      engCollect(&sim_units[EVQ_ID(msg)], EVQ_EVENT(msg));
+  }
+}
+
+bool engPostI(uint8_t msg)
+{
+  if (!evqPut(msg))
+  {
+    sim_dropped++;
+    return false;
+  }
+
+  sim_posted++;
+  if (!dispatch_timer.armed)
+    simTimerSet(&dispatch_timer, 0, simDispatch, NULL);
+  return true;
+}
+
+void engChangedI(intersection_t *isp, uint8_t changes)
+{
+  sim_changed(isp, changes);
+}
+
+/* No telemetry on the host */
+void engTelemetryI(uint8_t type, uint8_t id, uint8_t a, uint16_t b,
+                   systimestamp_t now)
+{
+  (void)type;
+  (void)id;
+  (void)a;
+  (void)b;
+  (void)now;
+}
+
+/* Same wiring as the board on the own ports of each intersection, the
+   first phase timers are armed by the first dispatch like on the board */
+void simEngineInit(int units, sim_changed_t changed)
+{
+  memset(sim_units, 0, sizeof(sim_units));
+  memset(&dispatch_timer, 0, sizeof(dispatch_timer));
+  sim_units_num = units;
+  sim_changed = changed;
+  evqInit();
+
+  for (int u = 0; u < units; u++)
+  {
+    for (int i = 0; i < LAMP_PORTS; i++)
+      sim_lamps[u].port[i] = SIM_UNIT_PORT(lamps_board.port[i], u);
+    sim_lamps[u].lut = lamps_board.lut;
+
+    engInit(&sim_units[u], (uint8_t)u, &sim_lamps[u]);
+    lampsInit(&sim_lamps[u]);
+    (void)engPostI(EVQ_MSG(u, EVQ_PHASE));
+  }
+  sim_posted = sim_dropped = sim_expiries = 0;
+  sim_laststamp = simTicks();
+}
@@ -0,0 +1,25 @@
+/*
+  * Host side of the firmware engine (engine.c): the intersections, their
+  * signal heads on the simulated ports and the engine hooks. A message
+  * posted to the event queue arms a dispatch timer on the virtual clock, so
+  * the collector runs after the event that posted it and at the same
+  * virtual time, like the collector thread runs after the interrupt, and
+  * the queue coalesces and prioritises the presses as on the board.
+*/
+
+#ifndef SIM_ENGINE_H
+#define SIM_ENGINE_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "engine.h"
+
+/* Controller changes of an intersection, the lamps are written here */
+typedef void (*sim_changed_t)(intersection_t *isp, uint8_t changes);
+
+extern intersection_t sim_units[SIM_INTERSECTIONS_MAX];
+extern uint64_t sim_posted, sim_dropped, sim_expiries;
+
+void simEngineInit(int units, sim_changed_t changed);
+
+#endif
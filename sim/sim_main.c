@@ -0,0 +1,223 @@
+/*
+  * Host simulation of the intersection controller.
+  *
+  * Runs the firmware engine (engine.c, see sim_engine.h) against the
+  * simulated PAL and the virtual clock, with random button presses, so hours of operation of one or more
+  * intersections run in seconds.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "sim_clock.h"
+#include "sim_engine.h"
+#include "controller.h"
+#include "lamps.h"
+#include "latency.h"
+
+#define AMBULANCE_PASS_MS 30000
+#define SOURCES_NUM       4
+
+typedef struct
+{
+  intersection_t *isp;
+  uint8_t event;
+  double per_hour;  // Mean presses per hour, zero disables the source
+  sim_timer_t timer;
+  uint32_t presses;
+} source_t;
+
+static const struct
+{
+  const char *name;
+  uint8_t event;
+} source_kinds[SOURCES_NUM] =
+{
+  {"pedestre",              PEDESTRE},
+  {"carro secundaria",      CARRO_SECUNDARIA},
+  {"ambulancia principal",  AMBULANCIA_PRINCIPAL},
+  {"ambulancia secundaria", AMBULANCIA_SECUNDARIA},
+};
+
+static source_t sources[SIM_INTERSECTIONS_MAX][SOURCES_NUM];
+static uint32_t phase_entries[SIM_INTERSECTIONS_MAX][PH_COUNT];
+static double rates[SOURCES_NUM] = {60, 30, 1, 1};
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+static FILE *trace_out;  // Presses written as a sim/replay trace
+
+static double rngUniform(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static uint32_t rngExpMs(double per_hour)
+{
+  return (uint32_t)(-log(rngUniform()) * 3600000.0 / per_hour) + 1;
+}
+
+/* The firmware Process Event writes the lamps and times the greens */
+static void changed(intersection_t *isp, uint8_t changes)
+{
+  if (changes & CTL_PHASE_CHANGED)
+    phase_entries[isp->id][isp->ctl.phase]++;
+  if (changes & CTL_LAMPS_CHANGED)
+  {
+    lampsWrite(isp->lamps, isp->ctl.lamps);
+    latLamps(&isp->lat, isp->ctl.lamps, (uint32_t)chVTGetTimeStampI());
+  }
+}
+
+static void sourcePress(void *arg);
+
+/* The firmware buttons interrupt, the collector runs on the next dispatch */
+static void sourceInput(source_t *sp)
+{
+  intersection_t *isp = sp->isp;
+
+  if (trace_out)
+    fprintf(trace_out, "%llu %u %u\n", (unsigned long long)simNow(), isp->id,
+            sp->event);
+
+  engPressI(isp, sp->event, chVTGetTimeStampI());
+}
+
+static void sourceRelease(void *arg)
+{
+  source_t *sp = arg;
+
+  /* The ambulance passed, its button is pressed again to release the preemption */
+  sourceInput(sp);
+  simTimerSet(&sp->timer, rngExpMs(sp->per_hour), sourcePress, sp);
+}
+
+static void sourcePress(void *arg)
+{
+  source_t *sp = arg;
+
+  sp->presses++;
+  sourceInput(sp);
+
+  if (sp->event == AMBULANCIA_PRINCIPAL || sp->event == AMBULANCIA_SECUNDARIA)
+    simTimerSet(&sp->timer, AMBULANCE_PASS_MS, sourceRelease, sp);
+  else
+    simTimerSet(&sp->timer, rngExpMs(sp->per_hour), sourcePress, sp);
+}
+
+static void intersectionStart(intersection_t *isp)
+{
+  phase_entries[isp->id][isp->ctl.phase]++;
+  lampsWrite(isp->lamps, isp->ctl.lamps);
+  latLamps(&isp->lat, isp->ctl.lamps, (uint32_t)chVTGetTimeStampI());
+
+  for (int i = 0; i < SOURCES_NUM; i++)
+  {
+    source_t *sp = &sources[isp->id][i];
+
+    sp->isp = isp;
+    sp->event = source_kinds[i].event;
+    sp->per_hour = rates[i];
+    if (sp->per_hour > 0)
+      simTimerSet(&sp->timer, rngExpMs(sp->per_hour), sourcePress, sp);
+  }
+}
+
+static void tracePad(ioportid_t port, uint8_t pad, uint8_t level)
+{
+  uint64_t t = simNow();
+
+  printf("%8llu.%03llu %u:%s%u %u\n", (unsigned long long)(t / 1000),
+         (unsigned long long)(t % 1000), port->unit, port->name, pad, level);
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-s speedup] [-t hours] [-n intersections] [-p ped/h] [-c cars/h] [-a amb/h] [-r seed] [-w trace] [-v]\n"
+          "  -s  virtual time speedup against the wall clock, 0 runs unpaced (default 1000)\n"
+          "  -w  writes the presses as a trace for sim/replay\n"
+          "  -v  prints every pad level change\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  double speed = 1000, hours = 1;
+  int count = 1, opt;
+  struct timespec t0, t1;
+
+  while ((opt = getopt(argc, argv, "s:t:n:p:c:a:r:w:v")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': speed = atof(optarg); break;
+      case 't': hours = atof(optarg); break;
+      case 'n': count = atoi(optarg); break;
+      case 'p': rates[0] = atof(optarg); break;
+      case 'c': rates[1] = atof(optarg); break;
+      case 'a': rates[2] = rates[3] = atof(optarg); break;
+      case 'r': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+      case 'w':
+        if ((trace_out = fopen(optarg, "w")) == NULL)
+        {
+          perror(optarg);
+          return 1;
+        }
+        fprintf(trace_out, "# <ms> <intersection> <button pad>\n");
+        break;
+      case 'v': simPalSetTrace(tracePad); break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (count < 1 || count > SIM_INTERSECTIONS_MAX)
+  {
+    fprintf(stderr, "%s: 1 to %d intersections\n", argv[0], SIM_INTERSECTIONS_MAX);
+    return 1;
+  }
+
+  simClockInit(speed);
+  simPalInit();
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  simEngineInit(count, changed);
+  for (int u = 0; u < count; u++)
+    intersectionStart(&sim_units[u]);
+
+  simRunUntil((uint64_t)(hours * 3600000.0));
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("simulated %d intersection(s) for %.2f h in %.3f s wall, %u port writes\n",
+         count, hours,
+         (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9,
+         sim_pal_writes);
+  printf("controller state %zu bytes per intersection\n", sizeof(controller_t));
+
+  for (int u = 0; u < count; u++)
+  {
+    intersection_t *isp = &sim_units[u];
+
+    printf("intersection %d\n", u);
+    for (int i = 0; i < SOURCES_NUM; i++)
+      printf("  %-22s %u presses\n", source_kinds[i].name, sources[u][i].presses);
+    for (int i = 0; i < PH_COUNT; i++)
+      printf("  phase %d entered %u times\n", i, phase_entries[u][i]);
+    for (int c = 0; c < LAT_CLASSES; c++)
+    {
+      const lat_hist_t *hp = &isp->lat.hist[c];
+
+      printf("  %-22s latency max %u ms, buckets", source_kinds[c].name, hp->max_ms);
+      for (int b = 0; b < LAT_BUCKETS; b++)
+        printf(" %u", hp->count[b]);
+      printf("\n");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <stddef.h>
+#include "hal.h"
+
+sim_port_t sim_ports[SIM_BOARD_PORTS * SIM_INTERSECTIONS_MAX];
+uint32_t sim_pal_writes;
+
+static sim_pal_trace_t pal_trace;
+
+static void simPalLevel(ioportid_t port, uint8_t pad, uint8_t level)
+{
+  uint8_t bit = PAL_PORT_BIT(pad);
+
+  /* Only level changes are traced */
+  if (((port->latch & bit) != 0) == (level != 0))
+    return;
+
+  port->latch = level ? (port->latch | bit) : (port->latch & ~bit);
+  if (pal_trace != NULL)
+    pal_trace(port, pad, level);
+}
+
+static void simPalWrite(ioportid_t port, uint8_t pad, uint8_t level)
+{
+  sim_pal_writes++;
+  simPalLevel(port, pad, level);
+}
+
+void simPalInit(void)
+{
+  static const char * const names[SIM_BOARD_PORTS] = {"PB", "PC", "PD"};
+
+  for (int i = 0; i < SIM_BOARD_PORTS * SIM_INTERSECTIONS_MAX; i++)
+  {
+    sim_ports[i].name = names[i % SIM_BOARD_PORTS];
+    sim_ports[i].unit = (uint8_t)(i / SIM_BOARD_PORTS);
+    sim_ports[i].latch = sim_ports[i].outputs = 0;
+  }
+  sim_pal_writes = 0;
+}
+
+void simPalSetTrace(sim_pal_trace_t trace)
+{
+  pal_trace = trace;
+}
+
+void palSetPadMode(ioportid_t port, uint8_t pad, uint8_t mode)
+{
+  if (mode == PAL_MODE_OUTPUT_PUSHPULL)
+    port->outputs |= PAL_PORT_BIT(pad);
+  else
+    port->outputs &= ~PAL_PORT_BIT(pad);
+}
+
+void palSetPad(ioportid_t port, uint8_t pad)
+{
+  simPalWrite(port, pad, PAL_HIGH);
+}
+
+void palClearPad(ioportid_t port, uint8_t pad)
+{
+  simPalWrite(port, pad, PAL_LOW);
+}
+
+void palTogglePad(ioportid_t port, uint8_t pad)
+{
+  simPalWrite(port, pad, (port->latch & PAL_PORT_BIT(pad)) ? PAL_LOW : PAL_HIGH);
+}
+
+/* One port write, the changed pads are traced one by one */
+void palWriteGroup(ioportid_t port, uint8_t mask, uint8_t offset, uint8_t bits)
+{
+  mask = (uint8_t)(mask << offset);
+  bits = (uint8_t)(bits << offset) & mask;
+
+  sim_pal_writes++;
+  for (uint8_t pad = 0; pad < 8; pad++)
+  {
+    if (mask & PAL_PORT_BIT(pad))
+      simPalLevel(port, pad, (bits & PAL_PORT_BIT(pad)) ? PAL_HIGH : PAL_LOW);
+  }
+}
+
+uint8_t palReadLatch(ioportid_t port)
+{
+  return port->latch;
+}
@@ -0,0 +1,51 @@
+/*
+  * Stacks high water marks.
+  *
+  * The main stack grows down from RAMEND towards the end of the .bss and
+  * .noinit sections (_end), the free memory between them is painted at
+  * startup and the peak is the painted area no longer intact. The threads
+  * stacks grow down towards the base of their working area, filled by the
+  * kernel when the thread is created.
+*/
+
+#include "hal.h"
+#include "stackmon.h"
+
+/* Bytes below the stack pointer left alone, the painting function frame */
+#define STK_PAINT_GUARD 16
+
+extern uint8_t _end;
+
+void stkPaint(uint8_t *base, uint16_t size)
+{
+  while (size--)
+    *base++ = STK_FILL_VALUE;
+}
+
+void stkPaintMain(void)
+{
+  uint8_t *top = (uint8_t *)SP - STK_PAINT_GUARD;
+
+  stkPaint(&_end, (uint16_t)(top - &_end));
+}
+
+uint16_t stkMainSize(void)
+{
+  return (uint16_t)(RAMEND + 1 - (uint16_t)&_end);
+}
+
+uint16_t stkMainPeak(void)
+{
+  return stkMainSize() - stkUnused(&_end, stkMainSize());
+}
+
+/* Untouched bytes from the base (lowest address) of a painted stack */
+uint16_t stkUnused(const uint8_t *base, uint16_t size)
+{
+  uint16_t n = 0;
+
+  while (n < size && base[n] == STK_FILL_VALUE)
+    n++;
+
+  return n;
+}
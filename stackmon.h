@@ -0,0 +1,23 @@
+#ifndef STACKMON_H
+#define STACKMON_H
+
+#include <stdint.h>
+
+/*
+  * Stacks high water marks. The AVR port has no interrupt stack, an
+  * interrupt runs on the stack of the thread it interrupts. The threads
+  * working areas are painted by the kernel (CH_DBG_FILL_THREADS), the idle
+  * thread one, created by chSysInit(), with stkPaint() before it and the
+  * main stack, main() and the interrupts taken while it runs, by
+  * stkPaintMain(). The CPU sleeps in the idle thread, most interrupts land
+  * on its working area.
+*/
+#define STK_FILL_VALUE 0x55
+
+void stkPaint(uint8_t *base, uint16_t size);
+void stkPaintMain(void);
+uint16_t stkMainSize(void);
+uint16_t stkMainPeak(void);
+uint16_t stkUnused(const uint8_t *base, uint16_t size);
+
+#endif
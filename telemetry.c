@@ -0,0 +1,117 @@
+/*
+  * Telemetry ring, records are queued by the event sources and framed by
+  * the serial monitor when it drains the ring.
+  *
+  * Producers run in ISR and thread context, they are serialized by the
+  * caller lock and never wait: when the ring is full the record is counted
+  * as dropped and a TLM_DROPPED record is queued as soon as there is room.
+  * The single consumer only writes its own index, as in evqueue.c.
+*/
+
+#include "telemetry.h"
+
+#if (TLM_RING_SIZE & (TLM_RING_SIZE - 1)) != 0 || TLM_RING_SIZE > 128
+#error "TLM_RING_SIZE must be a power of two not greater than 128"
+#endif
+
+#define TLM_MASK      (TLM_RING_SIZE - 1)
+
+/* Keeps the compiler from moving slot accesses across the index update */
+#define TLM_BARRIER() __asm__ volatile ("" : : : "memory")
+
+typedef struct
+{
+  uint8_t  type;
+  uint8_t  id;
+  uint8_t  a;
+  uint16_t b;
+  uint32_t time;
+} tlm_record_t;
+
+static tlm_record_t ring[TLM_RING_SIZE];
+static volatile uint8_t thead, ttail;
+static uint16_t dropped;
+static uint32_t dropped_time;
+static uint8_t seq;
+
+static uint8_t tlmFree(void)
+{
+  return TLM_RING_SIZE - (uint8_t)(thead - ttail);
+}
+
+static void tlmStore(uint8_t type, uint8_t id, uint8_t a, uint16_t b,
+                     uint32_t time)
+{
+  tlm_record_t *rp = &ring[thead & TLM_MASK];
+
+  rp->type = type;
+  rp->id = id;
+  rp->a = a;
+  rp->b = b;
+  rp->time = time;
+  TLM_BARRIER();
+  thead++;
+}
+
+void tlmInit(void)
+{
+  thead = ttail = 0;
+  dropped = 0;
+  seq = 0;
+}
+
+bool tlmPutI(uint8_t type, uint8_t id, uint8_t a, uint16_t b, uint32_t time)
+{
+  /* The drops are reported before the next record, when both fit.*/
+  if (dropped != 0)
+  {
+    if (tlmFree() < 2)
+    {
+      if (dropped < UINT16_MAX)
+        dropped++;
+      return false;
+    }
+    tlmStore(TLM_DROPPED, 0, 0, dropped, dropped_time);
+    dropped = 0;
+  }
+
+  if (tlmFree() == 0)
+  {
+    dropped = 1;
+    dropped_time = time;
+    return false;
+  }
+
+  tlmStore(type, id, a, b, time);
+  return true;
+}
+
+bool tlmGet(uint8_t *frame)
+{
+  const tlm_record_t *rp;
+  uint8_t sum = 0;
+
+  if (thead == ttail)
+    return false;
+
+  rp = &ring[ttail & TLM_MASK];
+  frame[0] = TLM_SYNC;
+  frame[1] = seq++;
+  frame[2] = rp->type;
+  frame[3] = rp->id;
+  frame[4] = rp->a;
+  frame[5] = (uint8_t)rp->b;
+  frame[6] = (uint8_t)(rp->b >> 8);
+  frame[7] = (uint8_t)rp->time;
+  frame[8] = (uint8_t)(rp->time >> 8);
+  frame[9] = (uint8_t)(rp->time >> 16);
+  frame[10] = (uint8_t)(rp->time >> 24);
+  TLM_BARRIER();
+  ttail++;
+
+  for (uint8_t i = 0; i < TLM_FRAME_SIZE - 1; i++)
+    sum += frame[i];
+  frame[TLM_FRAME_SIZE - 1] = (uint8_t)-sum;
+
+  return true;
+}
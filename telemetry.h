@@ -0,0 +1,35 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "definitions.h"
+
+/*
+  * Binary telemetry frames, 12 bytes, multi-byte fields little endian:
+  *   0      TLM_SYNC
+  *   1      Sequence number, a gap means frames lost on the wire
+  *   2      Record type (TLM_*)
+  *   3      Intersection
+  *   4      a
+  *   5..6   b
+  *   7..10  Low 32 bits of the system time stamp, in system ticks
+  *   11     Check, the 12 bytes sum to zero (mod 256)
+*/
+#define TLM_SYNC       0xA5
+#define TLM_FRAME_SIZE 12
+
+/* Record types and their a, b fields */
+#define TLM_BOOT     0 // a: format version, b: system ticks per second
+#define TLM_PHASE    1 // a: phase entered, b: lamps
+#define TLM_ARRIVAL  2 // a: button pad, b: presses of the button so far
+#define TLM_COLLECT  3 // a: button pad, b: messages left in the event queue
+#define TLM_DROPPED  4 // b: records dropped since the previous one
+
+#define TLM_VERSION  1
+
+void tlmInit(void);
+bool tlmPutI(uint8_t type, uint8_t id, uint8_t a, uint16_t b, uint32_t time);
+bool tlmGet(uint8_t *frame);
+
+#endif
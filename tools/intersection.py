@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""Generates the intersection headers from its declarative description.
+
+intersection.json describes the signal heads (lamp pins), the timings in
+milliseconds and the phases (lamps lit, blinking lamps, minimum and preempted
+durations, requests served and the ordered transition rules). Two headers
+are written:
+
+    intersection.h         wiring, timings, the phase_t enumeration and names
+    intersection_tables.h  phase descriptors and transition table in flash,
+                           included by controller.c only
+
+The lamp and request names are taken from controller.h, the generator
+checks the description against them and refuses phases lighting two
+conflicting heads at the same time.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+PORTS = {"B": "LAMP_PORT_B", "C": "LAMP_PORT_C", "D": "LAMP_PORT_D"}
+MS_MAX = 65534  # ctlWaitMs() keeps 65535 for CTL_WAIT_NONE
+
+
+class DescriptionError(Exception):
+    pass
+
+
+def bits(header, prefix):
+    """Maps the NAME of the '#define <prefix>NAME (1 << n)' lines to 1 << n."""
+    found = re.findall(r"#define\s+%s(\w+)\s+\(1 << (\d+)\)" % prefix, header)
+    return {name: 1 << int(shift) for name, shift in found}
+
+
+def lamp_name(ref):
+    head, _, color = ref.partition(".")
+    return "%s_%s" % (color.upper(), head.upper())
+
+
+def ms(timing, value, where):
+    if isinstance(value, str):
+        if value not in timing:
+            raise DescriptionError("%s: unknown timing '%s'" % (where, value))
+        return "TIMING_%s_MS" % value.upper(), timing[value]
+    if not isinstance(value, int):
+        raise DescriptionError("%s: duration must be a timing name or ms" % where)
+    return str(value), value
+
+
+def mask(names, table, prefix, where):
+    value, text = 0, []
+    for name in names:
+        if name not in table:
+            raise DescriptionError("%s: unknown %s%s" % (where, prefix, name))
+        value |= table[name]
+        text.append(prefix + name)
+    return value, " | ".join(text) if text else "0"
+
+
+def load(desc, lamps, reqs):
+    """Checks the description and returns the wiring, timings and phases."""
+    wiring, pads = {}, {}
+    for head, colors in desc["heads"].items():
+        for color, pin in colors.items():
+            lamp = lamp_name("%s.%s" % (head, color))
+            m = re.fullmatch(r"P([BCD])([0-7])", pin)
+            if lamp not in lamps:
+                raise DescriptionError("heads: no LAMP_%s in controller.h" % lamp)
+            if not m:
+                raise DescriptionError("heads: %s pin '%s' is not PB0..PD7" % (lamp, pin))
+            if pin in pads:
+                raise DescriptionError("heads: %s and %s share %s" % (pads[pin], lamp, pin))
+            pads[pin] = lamp
+            wiring[lamp] = (PORTS[m.group(1)], int(m.group(2)), pin)
+    missing = sorted(set(lamps) - set(wiring))
+    if missing:
+        raise DescriptionError("heads: LAMP_%s not wired" % ", LAMP_".join(missing))
+
+    timing = desc.get("timing_ms", {})
+    for name, value in timing.items():
+        if not isinstance(value, int) or not 0 < value <= MS_MAX:
+            raise DescriptionError("timing_ms: %s must be 1 to %d ms" % (name, MS_MAX))
+
+    names = [p["name"] for p in desc["phases"]]
+    if len(set(names)) != len(names):
+        raise DescriptionError("phases: duplicated names")
+
+    phases = []
+    for p in desc["phases"]:
+        where = "phase %s" % p["name"]
+        lit, lit_text = mask([lamp_name(r) for r in p["lit"]], lamps, "LAMP_", where)
+        blink, blink_text = mask([lamp_name(r) for r in p.get("blink", [])], lamps, "LAMP_", where)
+        preempt, preempt_text = mask(p.get("preempt", []), reqs, "REQ_", where)
+        _, serves_text = mask(p.get("serves", []), reqs, "REQ_", where)
+        min_text, min_ms = ms(timing, p["min_ms"], where)
+        preempt_ms_text, _ = ms(timing, p.get("preempt_ms", p["min_ms"]), where)
+        blink_ms_text, blink_ms = ms(timing, p["blink_ms"], where) if blink else ("0", 0)
+        if blink and blink_ms > min_ms:
+            raise DescriptionError("%s: blink_ms longer than min_ms" % where)
+
+        for lamps_on in (lit, lit ^ blink):
+            for a, b in desc.get("conflicts", []):
+                if showing(a, lamps_on, lamps) and showing(b, lamps_on, lamps):
+                    raise DescriptionError("%s: %s and %s open at the same time" % (where, a, b))
+
+        rules = p["next"]
+        if not rules or rules[-1].get("on"):
+            raise DescriptionError("%s: the last rule must have no 'on'" % where)
+        row = []
+        for req in range(1 << len(reqs)):
+            for rule in rules:
+                on, _ = mask(rule.get("on", []), reqs, "REQ_", where)
+                if not rule.get("on") or req & on:
+                    if rule["to"] not in names:
+                        raise DescriptionError("%s: unknown phase '%s'" % (where, rule["to"]))
+                    row.append(rule["to"])
+                    break
+
+        phases.append({"name": p["name"], "comment": p.get("comment"),
+                       "lamps": lit_text, "blink": blink_text,
+                       "ms": min_text, "preempt_ms": preempt_ms_text,
+                       "preempt": preempt_text, "serves": serves_text,
+                       "blink_ms": blink_ms_text, "next": row})
+    return wiring, timing, phases
+
+
+def showing(head, lamps_on, lamps):
+    """A head is open when any of its lamps but the red one is lit."""
+    suffix = "_" + head.upper()
+    return any(lamps_on & bit for name, bit in lamps.items()
+               if name.endswith(suffix) and not name.startswith("VERMELHO_"))
+
+
+def write_header(path, wiring, timing, phases):
+    with open(path, "w") as out:
+        out.write("/* Generated by tools/intersection.py from intersection.json, do not edit */\n\n")
+        out.write("#ifndef INTERSECTION_H\n#define INTERSECTION_H\n\n")
+
+        out.write("/* Lamps wiring, pad and port group of each one */\n")
+        width = max(len(lamp) for lamp in wiring) + 4
+        for lamp, (port, pad, pin) in wiring.items():
+            out.write("#define %-*s %d // %s\n" % (width, "LED_" + lamp, pad, pin))
+        out.write("\n")
+        for lamp, (port, pad, pin) in wiring.items():
+            out.write("#define %-*s %s\n" % (width + 5, "LED_%s_PORT" % lamp, port))
+
+        out.write("\n/* Timings, milliseconds */\n")
+        width = max(len(name) for name in timing) + 10
+        for name, value in timing.items():
+            out.write("#define %-*s %d\n" % (width, "TIMING_%s_MS" % name.upper(), value))
+
+        out.write("\n/* Phases, the row index of the transition table, the cycle starts on\n"
+                  "   the first one */\n")
+        out.write("typedef enum\n{\n")
+        for i, p in enumerate(phases):
+            item = "PH_%s%s," % (p["name"], " = 0" if i == 0 else "")
+            if p["comment"]:
+                item = "%-24s// %s" % (item, p["comment"])
+            out.write("  %s\n" % item)
+        out.write("  PH_COUNT\n} phase_t;\n\n")
+        out.write("#define PH_INITIAL PH_%s\n\n" % phases[0]["name"])
+        out.write("/* Phase names, initializer of a const char *[PH_COUNT] for the host tools */\n")
+        out.write("#define PH_NAMES \\\n")
+        out.write(", \\\n".join('  "%s"' % p["name"] for p in phases))
+        out.write("\n\n#endif\n")
+
+
+def write_tables(path, phases):
+    width = max(len(p["name"]) for p in phases) + 5
+    with open(path, "w") as out:
+        out.write("/* Generated by tools/intersection.py from intersection.json, do not edit.\n"
+                  "   Included by controller.c only. */\n\n")
+        out.write("static const phase_desc_t phases[PH_COUNT] ROM =\n{\n")
+        for p in phases:
+            out.write("  %-*s = {%s,\n" % (width, "[PH_%s]" % p["name"], p["lamps"]))
+            out.write("  %-*s    %s, %s, %s, %s, %s, %s},\n" % (
+                width, "", p["blink"], p["ms"], p["preempt_ms"], p["preempt"],
+                p["serves"], p["blink_ms"]))
+        out.write("};\n\n")
+
+        out.write("/* Next phase of each phase, indexed by the pending REQ_* mask */\n")
+        out.write("static const uint8_t transitions[PH_COUNT][REQ_COUNT] ROM =\n{\n")
+        for p in phases:
+            out.write("  [PH_%s] =\n  {\n" % p["name"])
+            row = ["PH_" + n for n in p["next"]]
+            for i in range(0, len(row), 4):
+                out.write("    %s,\n" % ", ".join(row[i:i + 4]))
+            out.write("  },\n")
+        out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("description", nargs="?", default=os.path.join(ROOT, "intersection.json"),
+                        help="intersection description (default intersection.json)")
+    parser.add_argument("-o", "--output", default=ROOT,
+                        help="directory of the generated headers (default the firmware root)")
+    args = parser.parse_args()
+
+    with open(os.path.join(ROOT, "controller.h")) as f:
+        header = f.read()
+    lamps, reqs = bits(header, "LAMP_"), bits(header, "REQ_")
+
+    with open(args.description) as f:
+        desc = json.load(f)
+    try:
+        wiring, timing, phases = load(desc, lamps, reqs)
+    except (DescriptionError, KeyError) as e:
+        sys.exit("%s: %s" % (args.description, e))
+
+    write_header(os.path.join(args.output, "intersection.h"), wiring, timing, phases)
+    write_tables(os.path.join(args.output, "intersection_tables.h"), phases)
+    print("%d lamps, %d phases" % (len(wiring), len(phases)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Prints the flash and RAM used by each module from a GNU ld map file.
+
+Flash is .text (code, vectors, PROGMEM tables) plus the .data initializers,
+RAM is .data plus .bss and .noinit. Modules are the object files, archive
+members are grouped by archive.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+FLASH_SECTIONS = {".text", ".data"}
+RAM_SECTIONS = {".data", ".bss", ".noinit"}
+
+OUTPUT = re.compile(r"^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+INPUT = re.compile(r"^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+INPUT_NAME = re.compile(r"^ (\.\S+|COMMON)$")
+INPUT_REST = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+FILL = re.compile(r"^ \*fill\*\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+
+
+def module(path):
+    name = os.path.basename(path.strip())
+    archive = re.match(r"(.*\.a)\(.*\)$", name)
+    return archive.group(1) if archive else name
+
+
+def parse(lines):
+    sizes = {}
+    sections = {}
+    section = None
+    pending = None
+    in_map = False
+
+    for line in lines:
+        line = line.rstrip("\n")
+        # The memory map starts with the LOAD lines, the headers before it
+        # are translated with the linker messages.
+        if line.startswith("LOAD "):
+            in_map = True
+        if not in_map:
+            continue
+
+        out = OUTPUT.match(line)
+        if out:
+            section = out.group(1)
+            if in_map:
+                sections[section] = int(out.group(3), 16)
+            continue
+        if line and not line[0].isspace() and not line.startswith("."):
+            section = None
+            continue
+
+        entry = INPUT.match(line)
+        fill = FILL.match(line)
+        if fill:
+            size, path = int(fill.group(2), 16), "(alignment)"
+        elif entry:
+            size, path = int(entry.group(3), 16), entry.group(4)
+        elif pending is not None and INPUT_REST.match(line):
+            rest = INPUT_REST.match(line)
+            size, path = int(rest.group(2), 16), rest.group(3)
+        else:
+            pending = line if INPUT_NAME.match(line) else None
+            continue
+        pending = None
+
+        if section is None or size == 0:
+            continue
+        flash, ram = sizes.setdefault(module(path), [0, 0])
+        if section in FLASH_SECTIONS:
+            flash += size
+        if section in RAM_SECTIONS:
+            ram += size
+        sizes[module(path)] = [flash, ram]
+
+    return sizes, sections
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", nargs="?", default="build/ch.map",
+                        help="linker map file (default build/ch.map)")
+    parser.add_argument("--flash", type=int, default=32768 - 2048,
+                        help="flash available to the application, bootloader excluded (default 30720)")
+    parser.add_argument("--ram", type=int, default=2048,
+                        help="RAM size (default 2048)")
+    args = parser.parse_args()
+
+    with open(args.map) as f:
+        sizes, sections = parse(f)
+    if not sizes:
+        sys.exit("%s: no allocated section found" % args.map)
+
+    # Alignment gaps not listed as fill, so the totals match the sections.
+    flash = sum(sections.get(s, 0) for s in FLASH_SECTIONS)
+    ram = sum(sections.get(s, 0) for s in RAM_SECTIONS)
+    gap = [flash - sum(v[0] for v in sizes.values()),
+           ram - sum(v[1] for v in sizes.values())]
+    if gap[0] > 0 or gap[1] > 0:
+        alignment = sizes.setdefault("(alignment)", [0, 0])
+        alignment[0] += max(gap[0], 0)
+        alignment[1] += max(gap[1], 0)
+
+    rows = sorted(sizes.items(), key=lambda kv: (-kv[1][0], -kv[1][1], kv[0]))
+
+    print("%-28s %7s %7s" % ("module", "flash", "ram"))
+    for name, (f_size, r_size) in rows:
+        if f_size or r_size:
+            print("%-28s %7d %7d" % (name, f_size, r_size))
+    print("%-28s %7d %7d" % ("total", flash, ram))
+    print("%-28s %7d %7d" % ("free", args.flash - flash, args.ram - ram))
+    print("RAM free is shared by the main stack and the interrupts.")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Generates stacks.h from the stack peaks reported by the serial monitor.
+
+Build with USE_STACK_REPORT=yes, exercise the board (buttons, ambulances,
+telemetry, latency dumps), send 's' on the serial port and capture the
+output. Each capture line
+
+    S <name> <working area size> <stack bytes> <peak bytes>
+
+gives the working area size the peak needs, the largest peak of all the
+captures plus the margin is written to stacks.h, used by the builds with
+USE_MEASURED_STACKS=yes. WA_IDLE_SIZE sets the port idle thread stack.
+"""
+
+import argparse
+import re
+import sys
+
+LINE = re.compile(rb"S ([a-z_]+) (\d+) (\d+) (\d+)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("captures", nargs="*", default=["-"],
+                        help="serial captures, - for stdin")
+    parser.add_argument("-m", "--margin", type=int, default=32,
+                        help="bytes added to every measured peak (default 32)")
+    parser.add_argument("-o", "--output", default="stacks.h",
+                        help="generated header (default stacks.h)")
+    args = parser.parse_args()
+
+    needed = {}
+    for capture in args.captures:
+        data = sys.stdin.buffer.read() if capture == "-" else open(capture, "rb").read()
+        for name, wa_size, stack, peak in LINE.findall(data):
+            name = name.decode()
+            wa_size, stack, peak = int(wa_size), int(stack), int(peak)
+            print("%-16s working area %4d, stack %4d, peak %4d" % (name, wa_size, stack, peak))
+            if wa_size == 0:
+                continue
+            # The working area adds the thread contexts to the requested size,
+            # only the unused part of the stack is reclaimed.
+            size = max(wa_size - (stack - peak) + args.margin, 0)
+            needed[name] = max(needed.get(name, 0), size)
+
+    if not needed:
+        sys.exit("no stack report line found")
+
+    with open(args.output, "w") as out:
+        out.write("/* Generated by tools/stacks.py from the measured stack peaks plus %d bytes,\n"
+                  "   do not edit */\n\n" % args.margin)
+        out.write("#ifndef STACKS_H\n#define STACKS_H\n\n")
+        for name in sorted(needed):
+            out.write("#define WA_%s_SIZE %d\n" % (name.upper(), needed[name]))
+        out.write("\n#endif\n")
+
+    for name in sorted(needed):
+        print("WA_%s_SIZE %d" % (name.upper(), needed[name]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Decodes the binary telemetry frames of the serial port (see telemetry.h).
+
+Reads a capture file, a serial device already configured (for example
+`stty -F /dev/ttyUSB0 115200 raw`) or stdin, prints one line per record.
+Text written by the serial monitor between frames (the `h` latency dump)
+is printed as is. --trace also writes the ARRIVAL records (the debounced
+button presses) as an input trace for sim/replay.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+SYNC = 0xA5
+FRAME_SIZE = 12
+
+DESCRIPTION = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           os.pardir, "intersection.json")
+PHASES = [p["name"] for p in json.load(open(DESCRIPTION))["phases"]]
+PADS = {4: "PEDESTRE", 3: "CARRO_SECUNDARIA", 2: "AMBULANCIA_PRINCIPAL",
+        1: "AMBULANCIA_SECUNDARIA"}
+
+
+def name(table, index):
+    if isinstance(table, dict):
+        return table.get(index, str(index))
+    return table[index] if index < len(table) else str(index)
+
+
+def describe(kind, ident, a, b):
+    if kind == 0:
+        return "BOOT     version %d, %d ticks/s" % (a, b)
+    if kind == 1:
+        return "PHASE    %d %s lamps 0x%02x" % (ident, name(PHASES, a), b)
+    if kind == 2:
+        return "ARRIVAL  %d %s press %d" % (ident, name(PADS, a), b)
+    if kind == 3:
+        return "COLLECT  %d %s queue %d" % (ident, name(PADS, a), b)
+    if kind == 4:
+        return "DROPPED  %d records" % b
+    return "TYPE %d   %d a %d b %d" % (kind, ident, a, b)
+
+
+class Decoder:
+    def __init__(self, hz, out, trace=None):
+        self.hz = hz
+        self.out = out
+        self.trace = trace
+        self.ticks = 0      # Unwrapped 32 bits time stamps of the trace
+        self.base = 0       # Trace time of the last BOOT, the board restarts at 0
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.seq = None
+        self.lost = 0
+        self.bad = 0
+
+    def flush_text(self, force=False):
+        while b"\n" in self.text or (force and self.text):
+            line, sep, rest = self.text.partition(b"\n")
+            if not sep and not force:
+                break
+            self.out.write(line.decode("ascii", "replace").rstrip("\r") + "\n")
+            self.text = bytearray(rest)
+
+    def frame(self, f):
+        seq, kind, ident, a = f[1], f[2], f[3], f[4]
+        b = f[5] | f[6] << 8
+        time = f[7] | f[8] << 8 | f[9] << 16 | f[10] << 24
+        if kind == 0 and b:
+            self.hz = b
+        if self.seq is not None and seq != (self.seq + 1) & 0xFF:
+            gap = (seq - self.seq - 1) & 0xFF
+            self.lost += gap
+            self.out.write("# %d frame(s) lost\n" % gap)
+        self.seq = seq
+        self.out.write("%12.4f  %3d  %s\n" % (time / self.hz, seq,
+                                             describe(kind, ident, a, b)))
+        if self.trace:
+            self.record(kind, ident, a, time)
+
+    def record(self, kind, ident, a, time):
+        if kind == 0:
+            self.base = self.ticks * 1000 // self.hz
+            self.ticks = 0
+            self.trace.write("# BOOT, the trace continues at %d ms\n" % self.base)
+            return
+        self.ticks += (time - self.ticks) & 0xFFFFFFFF
+        if kind == 2:
+            self.trace.write("%d %d %s\n" % (self.base + self.ticks * 1000 // self.hz,
+                                              ident, name(PADS, a)))
+
+    def feed(self, data):
+        self.buf += data
+        while self.buf:
+            if self.buf[0] != SYNC:
+                self.text.append(self.buf.pop(0))
+                continue
+            if len(self.buf) < FRAME_SIZE:
+                break
+            f = self.buf[:FRAME_SIZE]
+            if sum(f) & 0xFF:
+                self.bad += 1
+                self.text.append(self.buf.pop(0))
+                continue
+            self.flush_text(force=True)
+            del self.buf[:FRAME_SIZE]
+            self.frame(f)
+        self.flush_text()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-",
+                        help="capture file or serial device, - for stdin")
+    parser.add_argument("--hz", type=int, default=15624,
+                        help="system ticks per second until a BOOT record")
+    parser.add_argument("--trace", type=argparse.FileType("w"),
+                        help="writes the button presses as a sim/replay trace")
+    args = parser.parse_args()
+
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", 0)
+    decoder = Decoder(args.hz, sys.stdout, args.trace)
+    try:
+        while True:
+            data = source.read(256) if source is not sys.stdin.buffer else source.read1(256)
+            if not data:
+                break
+            decoder.feed(data)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    decoder.flush_text(force=True)
+    if decoder.lost or decoder.bad:
+        sys.stderr.write("%d frame(s) lost, %d bad check(s)\n" % (decoder.lost, decoder.bad))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Builds the default, size and speed variants and compares them.
+
+For each variant prints the flash and RAM totals from its linker map and,
+with --port, flashes the board with the cycle benchmark build
+(USE_CYCLE_BENCH=yes) and reads the hot paths cycle costs it prints at
+startup (min, avg, max CPU cycles and the runs too long for the counter).
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from size_report import FLASH_SECTIONS, RAM_SECTIONS, parse  # noqa: E402
+
+VARIANTS = ["default", "size", "speed"]
+PATHS = {"push", "pop", "phase_tick", "phase_run", "lamps"}  # C lines of the CycleBench
+CYCLES = re.compile(rb"C (\w+) (\d+) (\d+) (\d+) (\d+)")
+
+
+def build(variant, extra):
+    cmd = ["make", "USE_VARIANT=%s" % variant] + extra
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    builddir = subprocess.run(cmd + ["-s", "builddir"], check=True, stdout=subprocess.PIPE,
+                              universal_newlines=True).stdout.strip()
+    with open(os.path.join(builddir, "ch.map")) as f:
+        _, sections = parse(f)
+    return (sum(sections.get(s, 0) for s in FLASH_SECTIONS),
+            sum(sections.get(s, 0) for s in RAM_SECTIONS))
+
+
+def cycles(variant, port, timeout):
+    subprocess.run(["stty", "-F", port, "115200", "raw", "-echo"], check=True)
+    subprocess.run(["make", "USE_VARIANT=%s" % variant, "USE_CYCLE_BENCH=yes",
+                    "AVRDUDE_PORT=%s" % port, "flash"],
+                   check=True, stdout=subprocess.DEVNULL)
+    found = {}
+    data = b""
+    deadline = time.time() + timeout
+    with open(port, "rb", 0) as tty:
+        os.set_blocking(tty.fileno(), False)
+        while time.time() < deadline and not PATHS <= found.keys():
+            chunk = tty.read(256)
+            if chunk:
+                data += chunk
+                found = {m[0].decode(): tuple(map(int, m[1:])) for m in CYCLES.findall(data)}
+            else:
+                time.sleep(0.05)
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", help="serial port of the board, measures the cycles")
+    parser.add_argument("--timeout", type=float, default=10.0,
+                        help="seconds to wait for the cycle report (default 10)")
+    parser.add_argument("variants", nargs="*", default=VARIANTS)
+    args = parser.parse_args()
+
+    for variant in args.variants:
+        flash, ram = build(variant, ["USE_CYCLE_BENCH=yes"] if args.port else [])
+        line = "%-8s flash %6d  ram %5d" % (variant, flash, ram)
+        if args.port:
+            for name, (lo, avg, hi, over) in sorted(cycles(variant, args.port, args.timeout).items()):
+                line += "  %s %d/%d/%d" % (name, lo, avg, hi)
+                if over:
+                    line += " (%d overflowed)" % over
+        print(line)
+
+
+if __name__ == "__main__":
+    main()